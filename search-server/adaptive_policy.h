@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <limits>
+
+// Execution policy tag for FindTopDocuments and MatchDocument: the query is parsed first,
+// its work is estimated from the index and it runs sequentially or in parallel, whichever
+// the thresholds say is faster for that much work
+struct AdaptiveExecutionPolicy {
+};
+
+inline constexpr AdaptiveExecutionPolicy adaptive_execution{};
+
+// Crossover points where the parallel evaluation starts to pay for its setup. The defaults
+// are a rough guess for a few cores; SearchServer::CalibrateAdaptivePolicy measures them
+struct AdaptivePolicyThresholds {
+    // Postings of the plus words and prefix expansions of a FindTopDocuments query
+    size_t min_parallel_postings = 1 << 16;
+    // Words of a MatchDocument query, plus and minus words and expansions
+    size_t min_parallel_match_words = 1 << 10;
+};
+
+// A threshold that is never reached: the parallel evaluation did not win in calibration
+constexpr size_t NEVER_PARALLEL = std::numeric_limits<size_t>::max();
@@ -0,0 +1,603 @@
+#include "benchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <sys/resource.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t PERF_WARMUP_QUERY_COUNT = 16;
+
+uint64_t ElapsedNs(Clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+std::string GenerateWord(std::mt19937& generator, int max_length) {
+    const int length = std::uniform_int_distribution(1, max_length)(generator);
+    std::string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(std::uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+template <typename ExecutionPolicy>
+void RunQueries(ExecutionPolicy&& policy, const SearchServer& search_server,
+                const std::vector<std::string>& queries, PerfCounters* perf_counters, PolicyBenchmarkResult& result) {
+    std::vector<uint64_t> latencies;
+    latencies.reserve(queries.size());
+    std::vector<Document> documents;
+    if (perf_counters) {
+        // The counters only see the pool threads that exist at Start, a few queries start them
+        for (size_t i = 0; i < std::min(queries.size(), PERF_WARMUP_QUERY_COUNT); ++i) {
+            search_server.FindTopDocumentsPage(policy, queries[i], DocumentStatus::ACTUAL, 0, MAX_RESULT_DOCUMENT_COUNT, documents);
+        }
+        perf_counters->Start();
+    }
+    // The index is resident already, so the peak is the index plus what the queries add
+    const bool is_peak_reset = ResetPeakMemory();
+    const auto start = Clock::now();
+    for (const std::string_view query : queries) {
+        const auto query_start = Clock::now();
+        search_server.FindTopDocumentsPage(policy, query, DocumentStatus::ACTUAL, 0, MAX_RESULT_DOCUMENT_COUNT, documents);
+        for (const auto& document : documents) {
+            result.total_relevance += document.relevance;
+        }
+        latencies.push_back(ElapsedNs(query_start));
+    }
+    const double seconds = ElapsedNs(start) / 1e9;
+    if (perf_counters) {
+        result.query_counters = perf_counters->Stop();
+    }
+    result.queries_per_second = seconds > 0 ? queries.size() / seconds : 0;
+    result.query_latency = SummarizeLatencies(latencies);
+    result.peak_memory_kb = is_peak_reset ? GetPeakMemoryKb() : -1;
+}
+
+template <typename ExecutionPolicy>
+void RunRemovals(ExecutionPolicy&& policy, SearchServer& search_server,
+                 const std::vector<int>& ids_to_remove, PolicyBenchmarkResult& result) {
+    std::vector<uint64_t> latencies;
+    latencies.reserve(ids_to_remove.size());
+    for (const int document_id : ids_to_remove) {
+        const auto remove_start = Clock::now();
+        search_server.RemoveDocument(policy, document_id);
+        latencies.push_back(ElapsedNs(remove_start));
+    }
+    result.remove_latency = SummarizeLatencies(latencies);
+}
+
+// Replaces the last word of each document, in place or by removing and re-adding it. The
+// length stays the same: a longer document changes the term frequency of every one of its words
+LatencySummary RunUpdates(SearchServer& search_server, const std::vector<std::string>& documents,
+                          const std::vector<int>& ids_to_update, bool in_place) {
+    std::vector<uint64_t> latencies;
+    latencies.reserve(ids_to_update.size());
+    for (const int document_id : ids_to_update) {
+        const std::string& next = documents[(document_id + 1) % documents.size()];
+        const std::string& text_before = documents[document_id];
+        const std::string text = text_before.substr(0, text_before.rfind(' ') + 1) + next.substr(0, next.find(' '));
+        const auto update_start = Clock::now();
+        if (in_place) {
+            search_server.UpdateDocument(document_id, text, DocumentStatus::ACTUAL, {1, 2, 3});
+        } else {
+            search_server.RemoveDocument(document_id);
+            search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {1, 2, 3});
+        }
+        latencies.push_back(ElapsedNs(update_start));
+    }
+    return SummarizeLatencies(latencies);
+}
+
+}  // namespace
+
+ZipfDistribution::ZipfDistribution(int n, double exponent)
+    : cumulative_(std::max(n, 0))
+{
+    if (n <= 0) {
+        throw std::invalid_argument("Zipf distribution needs at least one rank");
+    }
+    double sum = 0;
+    for (int rank = 0; rank < n; ++rank) {
+        sum += 1.0 / std::pow(rank + 1, exponent);
+        cumulative_[rank] = sum;
+    }
+    for (double& value : cumulative_) {
+        value /= sum;
+    }
+}
+
+int ZipfDistribution::operator()(std::mt19937& generator) const {
+    const double point = std::uniform_real_distribution<>(0, 1)(generator);
+    const auto it = std::lower_bound(cumulative_.begin(), cumulative_.end(), point);
+    return std::min<int>(it - cumulative_.begin(), cumulative_.size() - 1);
+}
+
+CorpusGenerator::CorpusGenerator(const BenchmarkConfig& config)
+    : config_(config)
+    , generator_(config.seed)
+    , word_distribution_(config.dictionary_size, config.zipf_exponent)
+{
+    if (config.dictionary_size <= config.stop_word_count || config.query_length_mix.empty()
+        || config.champion_list_size < 0 || config.champion_min_postings < 0) {
+        throw std::invalid_argument("Invalid benchmark config");
+    }
+    // Phrase queries are cut from the documents, so there must be documents with words
+    if (config.document_count < 1 || config.min_document_words < 1 || config.min_document_words > config.max_document_words) {
+        throw std::invalid_argument("Invalid benchmark config");
+    }
+    // Words are drawn until the dictionary is full, so it must not exceed the distinct words
+    // of up to max_word_length letters
+    if (config.max_word_length <= 0) {
+        throw std::invalid_argument("max_word_length must be positive");
+    }
+    uint64_t distinct_word_count = 0;
+    uint64_t words_of_length = 1;
+    for (int length = 1; length <= config.max_word_length && distinct_word_count < static_cast<uint64_t>(config.dictionary_size); ++length) {
+        words_of_length *= 26;
+        distinct_word_count += words_of_length;
+    }
+    if (distinct_word_count < static_cast<uint64_t>(config.dictionary_size)) {
+        throw std::invalid_argument("dictionary_size exceeds the " + std::to_string(distinct_word_count)
+                                    + " words of up to max_word_length letters");
+    }
+    std::set<std::string> seen;
+    dictionary_.reserve(config.dictionary_size);
+    while (static_cast<int>(dictionary_.size()) < config.dictionary_size) {
+        auto word = GenerateWord(generator_, config.max_word_length);
+        if (seen.insert(word).second) {
+            dictionary_.push_back(std::move(word));
+        }
+    }
+}
+
+const std::vector<std::string>& CorpusGenerator::GetDictionary() const {
+    return dictionary_;
+}
+
+std::string CorpusGenerator::GetStopWords() const {
+    std::string result;
+    for (int i = 0; i < config_.stop_word_count; ++i) {
+        result += dictionary_[i];
+        result.push_back(' ');
+    }
+    return result;
+}
+
+std::string CorpusGenerator::GenerateText(int word_count, double minus_prob) {
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (minus_prob > 0 && std::uniform_real_distribution<>(0, 1)(generator_) < minus_prob) {
+            text.push_back('-');
+        }
+        text += dictionary_[word_distribution_(generator_)];
+    }
+    return text;
+}
+
+std::vector<std::string> CorpusGenerator::GenerateDocuments() {
+    std::vector<std::string> documents;
+    documents.reserve(config_.document_count);
+    std::uniform_int_distribution<int> length(config_.min_document_words, config_.max_document_words);
+    for (int i = 0; i < config_.document_count; ++i) {
+        documents.push_back(GenerateText(length(generator_), 0));
+    }
+    return documents;
+}
+
+std::vector<std::string> CorpusGenerator::GenerateQueries() {
+    std::vector<double> weights;
+    for (const auto& [_, weight] : config_.query_length_mix) {
+        weights.push_back(weight);
+    }
+    std::discrete_distribution<int> length_index(weights.begin(), weights.end());
+    std::vector<std::string> queries;
+    queries.reserve(config_.query_count);
+    for (int i = 0; i < config_.query_count; ++i) {
+        const int word_count = config_.query_length_mix[length_index(generator_)].first;
+        queries.push_back(GenerateText(word_count, config_.minus_word_ratio));
+    }
+    return queries;
+}
+
+std::vector<std::string> CorpusGenerator::GeneratePhraseQueries(const std::vector<std::string>& documents) {
+    std::vector<std::string> queries;
+    queries.reserve(config_.phrase_query_count);
+    std::uniform_int_distribution<size_t> document_index(0, documents.size() - 1);
+    for (int i = 0; i < config_.phrase_query_count; ++i) {
+        const auto words = SplitIntoWords(documents[document_index(generator_)]);
+        const size_t length = std::min<size_t>(config_.phrase_length, words.size());
+        const size_t start = std::uniform_int_distribution<size_t>(0, words.size() - length)(generator_);
+        std::string query = "\"";
+        for (size_t j = start; j < start + length; ++j) {
+            query += words[j];
+            query.push_back(j + 1 == start + length ? '"' : ' ');
+        }
+        if (config_.phrase_slop > 0) {
+            query += "~" + std::to_string(config_.phrase_slop);
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+void PrintLatencyJson(std::ostream& out, const LatencySummary& summary) {
+    out << "{\"count\": " << summary.count
+        << ", \"mean_us\": " << summary.mean_us
+        << ", \"p50_us\": " << summary.p50_us
+        << ", \"p99_us\": " << summary.p99_us
+        << ", \"p999_us\": " << summary.p999_us
+        << ", \"max_us\": " << summary.max_us << "}";
+}
+
+LatencySummary SummarizeLatencies(std::vector<uint64_t>& latencies_ns) {
+    LatencySummary result;
+    if (latencies_ns.empty()) {
+        return result;
+    }
+    std::sort(latencies_ns.begin(), latencies_ns.end());
+    const auto at = [&latencies_ns](double quantile) {
+        const size_t index = std::min(latencies_ns.size() - 1, static_cast<size_t>(quantile * latencies_ns.size()));
+        return latencies_ns[index] / 1000.0;
+    };
+    result.count = latencies_ns.size();
+    result.mean_us = std::accumulate(latencies_ns.begin(), latencies_ns.end(), 0.0) / latencies_ns.size() / 1000.0;
+    result.p50_us = at(0.5);
+    result.p99_us = at(0.99);
+    result.p999_us = at(0.999);
+    result.max_us = latencies_ns.back() / 1000.0;
+    return result;
+}
+
+LatencySummary SummarizeHistogram(const LatencyHistogram& histogram) {
+    LatencySummary result;
+    result.count = histogram.GetCount();
+    result.mean_us = histogram.GetMean() / 1000.0;
+    result.p50_us = histogram.GetQuantile(0.5) / 1000.0;
+    result.p99_us = histogram.GetQuantile(0.99) / 1000.0;
+    result.p999_us = histogram.GetQuantile(0.999) / 1000.0;
+    result.max_us = histogram.GetMax() / 1000.0;
+    return result;
+}
+
+long GetPeakMemoryKb() {
+    // VmHWM follows ResetPeakMemory, ru_maxrss is the fallback where /proc is not available
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line);) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::stol(line.substr(6));
+        }
+    }
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+bool ResetPeakMemory() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    clear_refs << "5";
+    clear_refs.flush();
+    return static_cast<bool>(clear_refs);
+}
+
+BenchmarkReport RunBenchmark(const BenchmarkConfig& config) {
+    BenchmarkReport report;
+    report.config = config;
+
+    CorpusGenerator corpus(config);
+    const auto documents = corpus.GenerateDocuments();
+    const auto queries = corpus.GenerateQueries();
+
+    SearchServerOptions options;
+    options.store_positions = config.store_positions;
+    options.lean_index = config.lean_index;
+    options.champion_list_size = config.champion_list_size;
+    options.champion_min_postings = config.champion_min_postings;
+    options.cold_postings_path = config.cold_postings_path;
+    options.resident_postings_budget = config.resident_postings_budget;
+    options.cold_pool_size = config.cold_pool_size;
+    if (!config.wal_path.empty()) {
+        std::remove(config.wal_path.c_str());
+        WriteAheadLogOptions log_options;
+        log_options.group_commit_records = config.wal_group_commit;
+        log_options.sync = config.wal_sync;
+        options.write_ahead_log = std::make_shared<WriteAheadLog>(config.wal_path, log_options);
+    }
+    std::optional<PerfCounters> perf_counters;
+    if (config.perf_counters) {
+        perf_counters.emplace();
+        report.perf_unavailable_reason = perf_counters->GetUnavailableReason();
+    }
+    PerfCounters* const perf = perf_counters && perf_counters->IsAvailable() ? &*perf_counters : nullptr;
+
+    SearchServer search_server(corpus.GetStopWords(), options);
+    if (perf) {
+        perf->Start();
+    }
+    const auto ingest_start = Clock::now();
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    report.ingest_seconds = ElapsedNs(ingest_start) / 1e9;
+    if (perf) {
+        report.ingest_counters = perf->Stop();
+    }
+    report.ingest_documents_per_second = report.ingest_seconds > 0 ? documents.size() / report.ingest_seconds : 0;
+    report.peak_memory_after_ingest_kb = GetPeakMemoryKb();
+    report.positional_index_bytes = search_server.GetPositionalIndexSize();
+    report.memory_after_ingest = search_server.GetMemoryStats();
+
+    if (options.write_ahead_log) {
+        options.write_ahead_log->Flush();
+        const auto replay_start = Clock::now();
+        SearchServerOptions replay_options;
+        replay_options.store_positions = config.store_positions;
+        replay_options.lean_index = config.lean_index;
+        replay_options.champion_list_size = config.champion_list_size;
+        replay_options.champion_min_postings = config.champion_min_postings;
+        replay_options.write_ahead_log = std::make_shared<WriteAheadLog>(config.wal_path);
+        SearchServer replayed_server(corpus.GetStopWords(), replay_options);
+        replayed_server.ReplayWriteAheadLog();
+        report.wal_replay_seconds = ElapsedNs(replay_start) / 1e9;
+        report.wal_replay_documents_per_second = report.wal_replay_seconds > 0 ? documents.size() / report.wal_replay_seconds : 0;
+    }
+
+    if (!config.cold_postings_path.empty()) {
+        const auto offload_start = Clock::now();
+        report.cold_list_count = search_server.OffloadColdPostings();
+        report.offload_seconds = ElapsedNs(offload_start) / 1e9;
+        report.memory_after_offload = search_server.GetMemoryStats();
+    }
+
+    report.policies.resize(2);
+    report.policies[0].policy = "seq";
+    report.policies[1].policy = "par";
+    RunQueries(std::execution::seq, search_server, queries, perf, report.policies[0]);
+    RunQueries(std::execution::par, search_server, queries, perf, report.policies[1]);
+
+    if (config.store_positions && config.phrase_query_count > 0) {
+        const auto phrase_queries = corpus.GeneratePhraseQueries(documents);
+        report.policies.resize(4);
+        report.policies[2].policy = "seq_phrase";
+        report.policies[3].policy = "par_phrase";
+        RunQueries(std::execution::seq, search_server, phrase_queries, perf, report.policies[2]);
+        RunQueries(std::execution::par, search_server, phrase_queries, perf, report.policies[3]);
+    }
+
+    const auto calibration_start = Clock::now();
+    report.adaptive_thresholds = search_server.CalibrateAdaptivePolicy();
+    report.adaptive_calibration_seconds = ElapsedNs(calibration_start) / 1e9;
+    RunQueries(adaptive_execution, search_server, queries, perf, report.policies.emplace_back());
+    report.policies.back().policy = "auto";
+    report.cold_postings = search_server.GetColdPostingStats();
+
+    // Removals run after all queries, each policy on its own slice of ids
+    std::vector<int> ids(documents.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    std::shuffle(ids.begin(), ids.end(), std::mt19937(config.seed));
+    const size_t remove_count = std::min<size_t>(config.remove_count, ids.size() / 2);
+    RunRemovals(std::execution::seq, search_server, std::vector<int>(ids.begin(), ids.begin() + remove_count), report.policies[0]);
+    RunRemovals(std::execution::par, search_server,
+                std::vector<int>(ids.begin() + remove_count, ids.begin() + 2 * remove_count), report.policies[1]);
+
+    // Edits go to documents still indexed, again on separate slices
+    const size_t update_begin = 2 * remove_count;
+    const size_t update_count = std::min<size_t>(config.update_count, (ids.size() - update_begin) / 2);
+    report.update_latency = RunUpdates(search_server, documents,
+                                       std::vector<int>(ids.begin() + update_begin, ids.begin() + update_begin + update_count), true);
+    report.readd_latency = RunUpdates(search_server, documents,
+                                      std::vector<int>(ids.begin() + update_begin + update_count, ids.begin() + update_begin + 2 * update_count), false);
+    return report;
+}
+
+void PrintBenchmarkJson(std::ostream& out, const BenchmarkReport& report) {
+    const auto& config = report.config;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"config\": {\"seed\": " << config.seed
+        << ", \"dictionary_size\": " << config.dictionary_size
+        << ", \"zipf_exponent\": " << config.zipf_exponent
+        << ", \"document_count\": " << config.document_count
+        << ", \"min_document_words\": " << config.min_document_words
+        << ", \"max_document_words\": " << config.max_document_words
+        << ", \"query_count\": " << config.query_count
+        << ", \"query_length_mix\": [";
+    for (size_t i = 0; i < config.query_length_mix.size(); ++i) {
+        out << (i == 0 ? "" : ", ") << "[" << config.query_length_mix[i].first << ", " << config.query_length_mix[i].second << "]";
+    }
+    out << "], \"minus_word_ratio\": " << config.minus_word_ratio
+        << ", \"remove_count\": " << config.remove_count
+        << ", \"update_count\": " << config.update_count
+        << ", \"store_positions\": " << (config.store_positions ? "true" : "false")
+        << ", \"phrase_query_count\": " << config.phrase_query_count
+        << ", \"phrase_length\": " << config.phrase_length
+        << ", \"phrase_slop\": " << config.phrase_slop
+        << ", \"wal_path\": \"" << config.wal_path << "\""
+        << ", \"wal_group_commit\": " << config.wal_group_commit
+        << ", \"wal_sync\": " << (config.wal_sync ? "true" : "false")
+        << ", \"lean_index\": " << (config.lean_index ? "true" : "false")
+        << ", \"champion_list_size\": " << config.champion_list_size
+        << ", \"champion_min_postings\": " << config.champion_min_postings
+        << ", \"perf_counters\": " << (config.perf_counters ? "true" : "false")
+        << ", \"cold_postings_path\": \"" << config.cold_postings_path << "\""
+        << ", \"resident_postings_budget\": " << config.resident_postings_budget
+        << ", \"cold_pool_size\": " << config.cold_pool_size << "},\n";
+    out << "  \"ingest\": {\"seconds\": " << report.ingest_seconds
+        << ", \"documents_per_second\": " << report.ingest_documents_per_second
+        << ", \"peak_memory_kb\": " << report.peak_memory_after_ingest_kb
+        << ", \"positional_index_bytes\": " << report.positional_index_bytes
+        << ", \"wal_replay_seconds\": " << report.wal_replay_seconds
+        << ", \"wal_replay_documents_per_second\": " << report.wal_replay_documents_per_second
+        << ", \"perf_per_document\": ";
+    PrintPerfCountsJson(out, report.ingest_counters, config.document_count);
+    out << "},\n";
+    if (config.perf_counters) {
+        out << "  \"perf_unavailable_reason\": \"" << report.perf_unavailable_reason << "\",\n";
+    }
+    out << "  \"memory\": ";
+    PrintMemoryStatsJson(out, report.memory_after_ingest);
+    out << ",\n";
+    if (!config.cold_postings_path.empty()) {
+        const ColdPostingStats& cold = report.cold_postings;
+        out << "  \"tiered\": {\"cold_lists\": " << report.cold_list_count
+            << ", \"offload_seconds\": " << report.offload_seconds
+            << ", \"file_bytes\": " << cold.file_bytes
+            << ", \"pool_size\": " << cold.pool_size
+            << ", \"resident_bytes\": " << cold.resident_bytes
+            << ", \"hits\": " << cold.hits
+            << ", \"misses\": " << cold.misses
+            << ", \"hit_rate\": " << cold.GetHitRate()
+            << ", \"evictions\": " << cold.evictions
+            << ", \"bytes_read\": " << cold.bytes_read
+            << ",\n    \"read_latency\": ";
+        PrintLatencyJson(out, SummarizeHistogram(cold.read_latency));
+        out << ",\n    \"memory\": ";
+        PrintMemoryStatsJson(out, report.memory_after_offload);
+        out << "},\n";
+    }
+    // null where the parallel evaluation never won
+    const auto print_threshold = [&out](size_t threshold) {
+        if (threshold == NEVER_PARALLEL) {
+            out << "null";
+        } else {
+            out << threshold;
+        }
+    };
+    out << "  \"adaptive\": {\"calibration_seconds\": " << report.adaptive_calibration_seconds << ", \"min_parallel_postings\": ";
+    print_threshold(report.adaptive_thresholds.min_parallel_postings);
+    out << ", \"min_parallel_match_words\": ";
+    print_threshold(report.adaptive_thresholds.min_parallel_match_words);
+    out << "},\n";
+    out << "  \"updates\": {\"in_place_latency\": ";
+    PrintLatencyJson(out, report.update_latency);
+    out << ", \"remove_add_latency\": ";
+    PrintLatencyJson(out, report.readd_latency);
+    out << "},\n";
+    out << "  \"policies\": [";
+    bool first = true;
+    for (const auto& result : report.policies) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\"policy\": \"" << result.policy << "\", \"qps\": " << result.queries_per_second
+            << ", \"total_relevance\": " << result.total_relevance
+            << ", \"peak_memory_kb\": " << result.peak_memory_kb
+            << ",\n     \"query_latency\": ";
+        PrintLatencyJson(out, result.query_latency);
+        out << ",\n     \"perf_per_query\": ";
+        PrintPerfCountsJson(out, result.query_counters, result.query_latency.count);
+        out << ",\n     \"remove_latency\": ";
+        PrintLatencyJson(out, result.remove_latency);
+        out << "}";
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+std::pair<std::string_view, std::string> SplitOption(std::string_view arg) {
+    const size_t pos = arg.find('=');
+    if (pos == arg.npos) {
+        throw std::invalid_argument("Expected key=value, got " + std::string(arg));
+    }
+    return {arg.substr(0, pos), std::string(arg.substr(pos + 1))};
+}
+
+std::vector<std::string> SplitList(const std::string& value) {
+    std::vector<std::string> result;
+    size_t begin = 0;
+    while (begin <= value.size()) {
+        size_t end = value.find(',', begin);
+        if (end == value.npos) {
+            end = value.size();
+        }
+        if (end > begin) {
+            result.push_back(value.substr(begin, end - begin));
+        }
+        begin = end + 1;
+    }
+    return result;
+}
+
+BenchmarkConfig ParseBenchmarkConfig(const std::vector<std::string_view>& args) {
+    BenchmarkConfig config;
+    for (const std::string_view arg : args) {
+        const auto [key, value] = SplitOption(arg);
+        if (key == "seed") {
+            config.seed = std::stoul(value);
+        } else if (key == "dictionary_size") {
+            config.dictionary_size = std::stoi(value);
+        } else if (key == "max_word_length") {
+            config.max_word_length = std::stoi(value);
+        } else if (key == "stop_word_count") {
+            config.stop_word_count = std::stoi(value);
+        } else if (key == "zipf_exponent") {
+            config.zipf_exponent = std::stod(value);
+        } else if (key == "document_count") {
+            config.document_count = std::stoi(value);
+        } else if (key == "min_document_words") {
+            config.min_document_words = std::stoi(value);
+        } else if (key == "max_document_words") {
+            config.max_document_words = std::stoi(value);
+        } else if (key == "query_count") {
+            config.query_count = std::stoi(value);
+        } else if (key == "minus_word_ratio") {
+            config.minus_word_ratio = std::stod(value);
+        } else if (key == "remove_count") {
+            config.remove_count = std::stoi(value);
+        } else if (key == "update_count") {
+            config.update_count = std::stoi(value);
+        } else if (key == "store_positions") {
+            config.store_positions = std::stoi(value) != 0;
+        } else if (key == "phrase_query_count") {
+            config.phrase_query_count = std::stoi(value);
+        } else if (key == "phrase_length") {
+            config.phrase_length = std::stoi(value);
+        } else if (key == "phrase_slop") {
+            config.phrase_slop = std::stoi(value);
+        } else if (key == "wal_path") {
+            config.wal_path = value;
+        } else if (key == "wal_group_commit") {
+            config.wal_group_commit = std::stoi(value);
+        } else if (key == "wal_sync") {
+            config.wal_sync = std::stoi(value) != 0;
+        } else if (key == "lean_index") {
+            config.lean_index = std::stoi(value) != 0;
+        } else if (key == "champion_list_size") {
+            config.champion_list_size = std::stoi(value);
+        } else if (key == "champion_min_postings") {
+            config.champion_min_postings = std::stoi(value);
+        } else if (key == "cold_postings_path") {
+            config.cold_postings_path = value;
+        } else if (key == "resident_postings_budget") {
+            config.resident_postings_budget = std::stoull(value);
+        } else if (key == "cold_pool_size") {
+            config.cold_pool_size = std::stoull(value);
+        } else if (key == "perf_counters") {
+            config.perf_counters = std::stoi(value) != 0;
+        } else if (key == "query_length_mix") {
+            // "1:0.3,2:0.5,5:0.2"
+            config.query_length_mix.clear();
+            for (const std::string& item : SplitList(value)) {
+                const size_t colon = item.find(':');
+                if (colon == item.npos) {
+                    throw std::invalid_argument("Expected length:weight, got " + item);
+                }
+                config.query_length_mix.emplace_back(std::stoi(item.substr(0, colon)), std::stod(item.substr(colon + 1)));
+            }
+        } else {
+            throw std::invalid_argument("Unknown benchmark option " + std::string(key));
+        }
+    }
+    return config;
+}
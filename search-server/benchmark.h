@@ -0,0 +1,148 @@
+#pragma once
+#include "latency_histogram.h"
+#include "perf_counters.h"
+#include "search_server.h"
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct BenchmarkConfig {
+    uint32_t seed = 42;
+    int dictionary_size = 10'000;
+    int max_word_length = 10;
+    int stop_word_count = 1;            // the most frequent dictionary words become stop words
+    double zipf_exponent = 1.0;         // 0 gives the old uniform distribution
+    int document_count = 10'000;
+    int min_document_words = 20;
+    int max_document_words = 70;
+    int query_count = 1'000;
+    // (number of words, weight) pairs, weights do not have to sum to one
+    std::vector<std::pair<int, double>> query_length_mix = {{1, 0.3}, {2, 0.3}, {3, 0.2}, {5, 0.15}, {10, 0.05}};
+    double minus_word_ratio = 0.1;
+    int remove_count = 100;             // documents removed per execution policy
+    int update_count = 100;             // one-word edits, applied in place and as remove plus add
+    bool store_positions = false;
+    int phrase_query_count = 0;         // needs store_positions
+    int phrase_length = 2;
+    int phrase_slop = 0;
+    std::string wal_path;               // ingest through a write-ahead log there and time its replay
+    int wal_group_commit = 64;          // records per write
+    bool wal_sync = true;
+    bool lean_index = false;
+    int champion_list_size = 0;         // 0 disables champion lists
+    int champion_min_postings = 1000;
+    // Count instructions, cycles, cache and branch misses per query and per ingested document
+    bool perf_counters = false;
+    // Tiered storage: after ingest the posting lists beyond the budget are moved to this file
+    std::string cold_postings_path;
+    size_t resident_postings_budget = 256 << 20;
+    size_t cold_pool_size = 64 << 20;
+};
+
+// Samples ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(int n, double exponent);
+
+    int operator()(std::mt19937& generator) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+class CorpusGenerator {
+public:
+    explicit CorpusGenerator(const BenchmarkConfig& config);
+
+    // Dictionary ordered by rank: dictionary[0] is the most frequent word
+    const std::vector<std::string>& GetDictionary() const;
+
+    std::string GetStopWords() const;
+
+    std::vector<std::string> GenerateDocuments();
+
+    std::vector<std::string> GenerateQueries();
+
+    // Quoted runs of consecutive words taken from the documents, so that most of them match
+    std::vector<std::string> GeneratePhraseQueries(const std::vector<std::string>& documents);
+
+private:
+    std::string GenerateText(int word_count, double minus_prob);
+
+    const BenchmarkConfig config_;
+    std::mt19937 generator_;
+    std::vector<std::string> dictionary_;
+    ZipfDistribution word_distribution_;
+};
+
+struct LatencySummary {
+    uint64_t count = 0;
+    double mean_us = 0;
+    double p50_us = 0;
+    double p99_us = 0;
+    double p999_us = 0;
+    double max_us = 0;
+};
+
+// Sorts the samples in place
+LatencySummary SummarizeLatencies(std::vector<uint64_t>& latencies_ns);
+
+LatencySummary SummarizeHistogram(const LatencyHistogram& histogram);
+
+void PrintLatencyJson(std::ostream& out, const LatencySummary& summary);
+
+struct PolicyBenchmarkResult {
+    std::string policy;
+    double queries_per_second = 0;
+    double total_relevance = 0;         // checksum that keeps the optimizer honest
+    LatencySummary query_latency;
+    LatencySummary remove_latency;
+    long peak_memory_kb = -1;           // peak resident set while its queries ran, -1 if unknown
+    PerfCounts query_counters;          // over all queries, with perf_counters
+};
+
+struct BenchmarkReport {
+    BenchmarkConfig config;
+    double ingest_documents_per_second = 0;
+    double ingest_seconds = 0;
+    long peak_memory_after_ingest_kb = 0;
+    size_t positional_index_bytes = 0;
+    MemoryStats memory_after_ingest;
+    PerfCounts ingest_counters;         // over all documents, with perf_counters
+    std::string perf_unavailable_reason;
+    double wal_replay_seconds = 0;
+    double wal_replay_documents_per_second = 0;
+    double adaptive_calibration_seconds = 0;
+    AdaptivePolicyThresholds adaptive_thresholds;
+    LatencySummary update_latency;      // UpdateDocument
+    LatencySummary readd_latency;       // the same edit as RemoveDocument and AddDocument
+    size_t cold_list_count = 0;         // with cold_postings_path
+    double offload_seconds = 0;
+    MemoryStats memory_after_offload;
+    ColdPostingStats cold_postings;     // after all queries
+    std::vector<PolicyBenchmarkResult> policies;
+};
+
+BenchmarkReport RunBenchmark(const BenchmarkConfig& config);
+
+void PrintBenchmarkJson(std::ostream& out, const BenchmarkReport& report);
+
+// Splits a "key=value" argument, throws std::invalid_argument without the '='
+std::pair<std::string_view, std::string> SplitOption(std::string_view arg);
+
+// Items of a comma-separated value, empty ones skipped
+std::vector<std::string> SplitList(const std::string& value);
+
+// Parses "key=value" arguments into the config, throws std::invalid_argument on unknown keys
+BenchmarkConfig ParseBenchmarkConfig(const std::vector<std::string_view>& args);
+
+// Peak resident set size of the process since it started or since the last ResetPeakMemory
+long GetPeakMemoryKb();
+
+// Restarts the peak GetPeakMemoryKb reports from the current resident set; false where the
+// kernel does not allow it
+bool ResetPeakMemory();
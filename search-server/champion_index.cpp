@@ -0,0 +1,79 @@
+#include "champion_index.h"
+#include <algorithm>
+
+ChampionIndex::ChampionIndex(size_t list_size)
+    : list_size_(list_size) {
+}
+
+bool ChampionIndex::IsBetter(const Entry& lhs, const Entry& rhs) {
+    if (lhs.term_freq != rhs.term_freq) {
+        return lhs.term_freq > rhs.term_freq;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.document_id < rhs.document_id;
+}
+
+void ChampionIndex::Build(std::string_view word, std::vector<Entry> postings) {
+    List& list = word_to_list_[word];
+    entry_count_ -= list.entries.size();
+    entry_bytes_ -= GetVectorHeapSize(list.entries);
+    const size_t capacity = std::min(2 * list_size_, postings.size());
+    std::partial_sort(postings.begin(), postings.begin() + capacity, postings.end(), IsBetter);
+    list.outside_max_term_freq = 0;
+    for (auto it = postings.begin() + capacity; it != postings.end(); ++it) {
+        list.outside_max_term_freq = std::max(list.outside_max_term_freq, it->term_freq);
+    }
+    list.entries.assign(postings.begin(), postings.begin() + capacity);
+    entry_count_ += list.entries.size();
+    entry_bytes_ += GetVectorHeapSize(list.entries);
+}
+
+void ChampionIndex::Add(std::string_view word, const Entry& entry) {
+    const auto list_it = word_to_list_.find(word);
+    if (list_it == word_to_list_.end()) {
+        return;
+    }
+    List& list = list_it->second;
+    auto& entries = list.entries;
+    const bool is_full = entries.size() >= 2 * list_size_;
+    if (is_full && !IsBetter(entry, entries.back())) {
+        list.outside_max_term_freq = std::max(list.outside_max_term_freq, entry.term_freq);
+        return;
+    }
+    entry_bytes_ -= GetVectorHeapSize(entries);
+    if (is_full) {
+        list.outside_max_term_freq = std::max(list.outside_max_term_freq, entries.back().term_freq);
+        entries.pop_back();
+        --entry_count_;
+    }
+    entries.insert(std::upper_bound(entries.begin(), entries.end(), entry, IsBetter), entry);
+    ++entry_count_;
+    entry_bytes_ += GetVectorHeapSize(entries);
+}
+
+bool ChampionIndex::Remove(std::string_view word, const Entry& entry) {
+    const auto list_it = word_to_list_.find(word);
+    if (list_it == word_to_list_.end()) {
+        return false;
+    }
+    List& list = list_it->second;
+    auto& entries = list.entries;
+    // The bound stays as it is, a larger one is still a bound
+    const auto it = std::lower_bound(entries.begin(), entries.end(), entry, IsBetter);
+    if (it != entries.end() && it->document_id == entry.document_id) {
+        entries.erase(it);
+        --entry_count_;
+    }
+    return entries.size() < list_size_ && list.outside_max_term_freq > 0;
+}
+
+const ChampionIndex::List* ChampionIndex::GetList(std::string_view word) const {
+    const auto it = word_to_list_.find(word);
+    return it == word_to_list_.end() ? nullptr : &it->second;
+}
+
+StructureMemory ChampionIndex::GetMemoryUsage() const {
+    return {entry_count_, word_to_list_.size() * GetTreeNodeSize<decltype(word_to_list_)>() + entry_bytes_};
+}
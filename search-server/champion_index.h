@@ -0,0 +1,49 @@
+#pragma once
+#include "memory_stats.h"
+#include <map>
+#include <string_view>
+#include <vector>
+
+// Champion lists of the frequent terms: the documents with the highest term frequency,
+// ties broken by the higher rating and then the lower id. A list keeps up to twice the
+// configured size, so removals rarely force a rebuild, and remembers an upper bound of
+// the term frequencies of the documents left out of it.
+class ChampionIndex {
+public:
+    struct Entry {
+        double term_freq;
+        int rating;
+        int document_id;
+    };
+
+    struct List {
+        std::vector<Entry> entries;  // best first
+        double outside_max_term_freq = 0;  // zero if no document of the term is left out
+    };
+
+    explicit ChampionIndex(size_t list_size = 0);
+
+    // Champion order
+    static bool IsBetter(const Entry& lhs, const Entry& rhs);
+
+    // Replaces the word's list with the best of postings, which may be in any order
+    void Build(std::string_view word, std::vector<Entry> postings);
+
+    // Offers a new posting of a word that has a list
+    void Add(std::string_view word, const Entry& entry);
+
+    // Drops a removed posting; true if the list has shrunk below the configured size
+    // while documents are left out of it, the caller should build it again then
+    bool Remove(std::string_view word, const Entry& entry);
+
+    // nullptr for words without a list
+    const List* GetList(std::string_view word) const;
+
+    StructureMemory GetMemoryUsage() const;
+
+private:
+    const size_t list_size_;
+    std::map<std::string_view, List> word_to_list_;
+    size_t entry_count_ = 0;
+    size_t entry_bytes_ = 0;
+};
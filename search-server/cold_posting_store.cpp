@@ -0,0 +1,280 @@
+#include "cold_posting_store.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+// A list is its postings in id order, each the id as a varint delta to the previous one
+// followed by the term frequency as the 8 bytes of the double
+void PutVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint32_t GetVarint(const char*& ptr, const char* end) {
+    uint32_t value = 0;
+    for (int shift = 0; ptr != end && shift < 35; shift += 7) {
+        const auto byte = static_cast<uint8_t>(*ptr++);
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Corrupted cold posting list");
+}
+
+}  // namespace
+
+double ColdPostingStats::GetHitRate() const {
+    return hits + misses == 0 ? 0 : hits * 1.0 / (hits + misses);
+}
+
+ColdPostingStore::PinSet::PinSet(PinSet&& other) noexcept
+    : store_(other.store_)
+    , words_(std::move(other.words_)) {
+    other.store_ = nullptr;
+    other.words_.clear();
+}
+
+ColdPostingStore::PinSet::~PinSet() {
+    for (const std::string_view word : words_) {
+        store_->Unpin(word);
+    }
+}
+
+void ColdPostingStore::PinSet::Pin(ColdPostingStore& store, std::string_view word) {
+    if (store.Pin(word)) {
+        store_ = &store;
+        words_.push_back(word);
+    }
+}
+
+ColdPostingStore::ColdPostingStore(std::string path, size_t pool_size)
+    : path_(std::move(path))
+    , pool_size_(pool_size) {
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        ThrowSystemError("Cannot create cold posting file " + path_);
+    }
+}
+
+ColdPostingStore::~ColdPostingStore() {
+    ::close(fd_);
+    ::unlink(path_.c_str());
+}
+
+void ColdPostingStore::Add(std::string_view word, Postings& postings) {
+    if (entries_.count(word) > 0) {
+        throw std::invalid_argument("Posting list of " + std::string(word) + " is already cold");
+    }
+    std::string data;
+    data.reserve(postings.size() * (sizeof(double) + 2));
+    int previous_id = 0;
+    for (const auto [document_id, term_freq] : postings) {
+        PutVarint(data, static_cast<uint32_t>(document_id - previous_id));
+        previous_id = document_id;
+        data.append(reinterpret_cast<const char*>(&term_freq), sizeof(term_freq));
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        const ssize_t count = ::pwrite(fd_, data.data() + written, data.size() - written, file_size_ + written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            ThrowSystemError("Cannot write cold posting file " + path_);
+        }
+        written += count;
+    }
+    entries_.emplace(word, Entry{&postings, file_size_, data.size(), postings.size(), 0, false, {}});
+    file_size_ += data.size();
+    posting_count_ += postings.size();
+    Postings().swap(postings);
+}
+
+bool ColdPostingStore::Contains(std::string_view word) const {
+    return entries_.count(word) > 0;
+}
+
+size_t ColdPostingStore::GetPostingCount(std::string_view word) const {
+    return entries_.at(word).posting_count;
+}
+
+bool ColdPostingStore::Pin(std::string_view word) {
+    const auto it = entries_.find(word);
+    if (it == entries_.end()) {
+        return false;
+    }
+    Entry& entry = it->second;
+    {
+        std::lock_guard guard(mutex_);
+        ++entry.pin_count;
+        if (entry.is_resident) {
+            ++hits_;
+            lru_.splice(lru_.begin(), lru_, entry.lru_position);
+            return true;
+        }
+        ++misses_;
+    }
+    // Read without the lock, so that misses of different lists overlap; a list two queries
+    // miss at once is read twice and installed once
+    Postings postings;
+    const auto start = std::chrono::steady_clock::now();
+    try {
+        postings = ReadList(entry);
+    } catch (...) {
+        std::lock_guard guard(mutex_);
+        --entry.pin_count;
+        throw;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    std::lock_guard guard(mutex_);
+    read_latency_.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    bytes_read_ += entry.byte_count;
+    if (!entry.is_resident) {
+        InstallLocked(it->first, entry, postings);
+    }
+    return true;
+}
+
+void ColdPostingStore::Unpin(std::string_view word) {
+    Entry& entry = entries_.at(word);
+    std::lock_guard guard(mutex_);
+    --entry.pin_count;
+    if (resident_bytes_ > pool_size_) {
+        EvictLocked();
+    }
+}
+
+void ColdPostingStore::Promote(std::string_view word) {
+    const auto it = entries_.find(word);
+    if (it == entries_.end()) {
+        return;
+    }
+    Entry& entry = it->second;
+    if (entry.is_resident) {
+        lru_.erase(entry.lru_position);
+        resident_bytes_ -= GetListBytes(entry.posting_count);
+        resident_posting_count_ -= entry.posting_count;
+    } else {
+        *entry.postings = ReadList(entry);
+    }
+    // The bytes stay in the file as garbage until the index offloads its lists again
+    posting_count_ -= entry.posting_count;
+    entries_.erase(it);
+}
+
+size_t ColdPostingStore::GetOffloadedPostingCount() const {
+    std::lock_guard guard(mutex_);
+    return posting_count_ - resident_posting_count_;
+}
+
+StructureMemory ColdPostingStore::GetMemoryUsage() const {
+    std::lock_guard guard(mutex_);
+    // An unordered_map node is the next link, the value and the cached hash; a list node
+    // is two links and the value
+    return {entries_.size(),
+        entries_.size() * GetMallocChunkSize(sizeof(void*) + sizeof(decltype(entries_)::value_type) + sizeof(size_t))
+        + GetMallocChunkSize(entries_.bucket_count() * sizeof(void*))
+        + lru_.size() * GetMallocChunkSize(2 * sizeof(void*) + sizeof(std::string_view))};
+}
+
+void ColdPostingStore::Rename(const std::string& path) {
+    if (std::rename(path_.c_str(), path.c_str()) != 0) {
+        ThrowSystemError("Cannot rename cold posting file " + path_ + " to " + path);
+    }
+    path_ = path;
+}
+
+ColdPostingStats ColdPostingStore::GetStats() const {
+    std::lock_guard guard(mutex_);
+    ColdPostingStats stats;
+    stats.list_count = entries_.size();
+    stats.posting_count = posting_count_;
+    stats.file_bytes = file_size_;
+    stats.pool_size = pool_size_;
+    stats.resident_list_count = lru_.size();
+    stats.resident_bytes = resident_bytes_;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.bytes_read = bytes_read_;
+    stats.read_latency = read_latency_;
+    return stats;
+}
+
+size_t ColdPostingStore::GetListBytes(size_t posting_count) {
+    return posting_count * GetTreeNodeSize<Postings>();
+}
+
+ColdPostingStore::Postings ColdPostingStore::ReadList(const Entry& entry) const {
+    std::string data(entry.byte_count, '\0');
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t count = ::pread(fd_, data.data() + done, data.size() - done, entry.offset + done);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            ThrowSystemError("Cannot read cold posting file " + path_);
+        }
+        if (count == 0) {
+            throw std::runtime_error("Cold posting file " + path_ + " is truncated");
+        }
+        done += count;
+    }
+    Postings postings;
+    const char* ptr = data.data();
+    const char* const end = ptr + data.size();
+    int document_id = 0;
+    while (ptr != end) {
+        document_id += static_cast<int>(GetVarint(ptr, end));
+        if (end - ptr < static_cast<ptrdiff_t>(sizeof(double))) {
+            throw std::runtime_error("Corrupted cold posting list");
+        }
+        double term_freq;
+        std::memcpy(&term_freq, ptr, sizeof(term_freq));
+        ptr += sizeof(term_freq);
+        // Ids ascend, so every node goes to the end of the tree
+        postings.emplace_hint(postings.end(), document_id, term_freq);
+    }
+    return postings;
+}
+
+void ColdPostingStore::InstallLocked(std::string_view word, Entry& entry, Postings& postings) {
+    entry.postings->swap(postings);
+    entry.is_resident = true;
+    entry.lru_position = lru_.insert(lru_.begin(), word);
+    resident_bytes_ += GetListBytes(entry.posting_count);
+    resident_posting_count_ += entry.posting_count;
+    EvictLocked();
+}
+
+void ColdPostingStore::EvictLocked() {
+    for (auto it = lru_.end(); resident_bytes_ > pool_size_ && it != lru_.begin();) {
+        --it;
+        Entry& entry = entries_.at(*it);
+        if (entry.pin_count > 0) {
+            continue;
+        }
+        Postings().swap(*entry.postings);
+        entry.is_resident = false;
+        resident_bytes_ -= GetListBytes(entry.posting_count);
+        resident_posting_count_ -= entry.posting_count;
+        ++evictions_;
+        it = lru_.erase(it);
+    }
+}
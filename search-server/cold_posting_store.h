@@ -0,0 +1,127 @@
+#pragma once
+#include "latency_histogram.h"
+#include "memory_stats.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct ColdPostingStats {
+    size_t list_count = 0;          // lists in the file
+    size_t posting_count = 0;
+    size_t file_bytes = 0;
+    size_t pool_size = 0;           // capacity of the buffer pool in bytes
+    size_t resident_list_count = 0;
+    size_t resident_bytes = 0;      // may exceed pool_size while pinned lists do not fit
+    uint64_t hits = 0;              // pins of lists already loaded
+    uint64_t misses = 0;            // pins that read the list from the file
+    uint64_t evictions = 0;
+    uint64_t bytes_read = 0;
+    LatencyHistogram read_latency;  // nanoseconds to read and decode one list
+
+    double GetHitRate() const;
+};
+
+// Second tier of the inverted index: posting lists written to a spill file and loaded back
+// on demand into their maps in the index, which stay empty while a list is not loaded.
+// Loaded lists form an LRU buffer pool of pool_size bytes. Lists pinned by running queries
+// are never evicted, the pool holds more than its size while they do not fit. The file is
+// read with pread and only lives as long as the store.
+// Pin and Unpin are thread-safe; Add and Promote must not run concurrently with anything.
+class ColdPostingStore {
+public:
+    using Postings = std::map<int, double>;
+
+    // The lists of one query, unpinned when it ends
+    class PinSet {
+    public:
+        PinSet() = default;
+        PinSet(PinSet&& other) noexcept;
+        PinSet& operator=(PinSet&& other) = delete;
+        ~PinSet();
+
+        // Pins the word if it is cold
+        void Pin(ColdPostingStore& store, std::string_view word);
+
+    private:
+        ColdPostingStore* store_ = nullptr;
+        std::vector<std::string_view> words_;
+    };
+
+    // Creates the file, replacing any file of that name. Throws std::system_error
+    ColdPostingStore(std::string path, size_t pool_size);
+    ~ColdPostingStore();
+
+    ColdPostingStore(const ColdPostingStore&) = delete;
+    ColdPostingStore& operator=(const ColdPostingStore&) = delete;
+
+    // Appends the postings to the file and empties the map, which is where they are loaded
+    // back to; the word and the map have to outlive the store
+    void Add(std::string_view word, Postings& postings);
+
+    bool Contains(std::string_view word) const;
+
+    // Document frequency of a cold word, without loading its list
+    size_t GetPostingCount(std::string_view word) const;
+
+    // Loads the list if it is not loaded and keeps it until the matching Unpin. Returns false
+    // for words that are not cold. Throws std::system_error if the file cannot be read
+    bool Pin(std::string_view word);
+    void Unpin(std::string_view word);
+
+    // Loads the list for good and forgets it, before the index changes it; does nothing for
+    // words that are not cold
+    void Promote(std::string_view word);
+
+    // Postings in the file that are not loaded, they take no memory in the index
+    size_t GetOffloadedPostingCount() const;
+
+    // The directory and the LRU list
+    StructureMemory GetMemoryUsage() const;
+
+    // Renames the file, the store keeps using it
+    void Rename(const std::string& path);
+
+    ColdPostingStats GetStats() const;
+
+private:
+    struct Entry {
+        Postings* postings;
+        uint64_t offset;
+        uint64_t byte_count;
+        size_t posting_count;
+        size_t pin_count = 0;
+        bool is_resident = false;
+        std::list<std::string_view>::iterator lru_position;  // valid while resident
+    };
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t file_size_ = 0;
+    const size_t pool_size_;
+    std::unordered_map<std::string_view, Entry> entries_;
+    size_t posting_count_ = 0;
+
+    mutable std::mutex mutex_;  // guards everything below and the fields of the entries
+    std::list<std::string_view> lru_;  // loaded lists, the most recently pinned first
+    size_t resident_bytes_ = 0;
+    size_t resident_posting_count_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    uint64_t evictions_ = 0;
+    uint64_t bytes_read_ = 0;
+    LatencyHistogram read_latency_;
+
+    static size_t GetListBytes(size_t posting_count);
+
+    Postings ReadList(const Entry& entry) const;
+
+    // Places a loaded list into its map and frees unpinned lists beyond the pool size
+    void InstallLocked(std::string_view word, Entry& entry, Postings& postings);
+    void EvictLocked();
+};
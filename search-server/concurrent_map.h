@@ -1,50 +1,247 @@
 #pragma once
 #include <algorithm>
+#include <cstdint>
 #include <cstdlib>
+#include <execution>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <numeric>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
-#include <mutex>
-
 
-template <typename Key, typename Value>
+// Hash map for concurrent updates. Keys are spread over shard_count shards (lock striping),
+// each an open-addressing table with linear probing behind its own mutex; every operation
+// locks exactly one shard, the exports lock them all. Any key with a Hash and a KeyEqual
+// works, the sorted exports also need operator<.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
 class ConcurrentMap {
-public:
-    static_assert(std::is_integral_v<Key>, "ConcurrentMap supports only integer keys");
+private:
+    struct Shard;
 
+public:
+    // Holds the shard of the key locked while the value is in use. Another access to the
+    // same shard from the same thread meanwhile deadlocks.
     struct Access {
-    
-        Access(std::mutex& m, std::map<Key, Value>& sub_map, const Key& key) : guard(m), ref_to_value(sub_map[key]){
-        } 
+        Access(Shard& shard, const ConcurrentMap& map, const Key& key, size_t hash)
+            : guard(shard.mutex)
+            , ref_to_value(map.FindOrInsert(shard, key, hash)) {
+        }
 
         std::lock_guard<std::mutex> guard;
         Value& ref_to_value;
     };
 
-    explicit ConcurrentMap(size_t bucket_count) : storage_(bucket_count), mutexes_(bucket_count), count_(bucket_count) {}
+    explicit ConcurrentMap(size_t shard_count)
+        : shards_(std::max<size_t>(shard_count, 1)) {
+    }
+
+    Access operator[](const Key& key) {
+        const size_t hash = GetHash(key);
+        return Access(GetShard(hash), *this, key, hash);
+    }
+
+    // Calls function(value) under the lock, the value is default-constructed if new
+    template <typename Function>
+    void Update(const Key& key, Function function) {
+        const size_t hash = GetHash(key);
+        Shard& shard = GetShard(hash);
+        std::lock_guard guard(shard.mutex);
+        function(FindOrInsert(shard, key, hash));
+    }
+
+    // Calls function(value, update) for every (key, update) pair, locking every shard once
+    // for all of its keys; pairs with the same key are applied in their order
+    template <typename Update, typename Function>
+    void UpdateBatch(const std::vector<std::pair<Key, Update>>& updates, Function function) {
+        std::vector<size_t> hashes(updates.size());
+        std::vector<size_t> shard_begins(shards_.size() + 1);
+        for (size_t i = 0; i < updates.size(); ++i) {
+            hashes[i] = GetHash(updates[i].first);
+            ++shard_begins[GetShardIndex(hashes[i]) + 1];
+        }
+        std::partial_sum(shard_begins.begin(), shard_begins.end(), shard_begins.begin());
+        // A counting sort by shard, stable so that updates of one key keep their order
+        std::vector<size_t> order(updates.size());
+        std::vector<size_t> positions(shard_begins.begin(), shard_begins.end() - 1);
+        for (size_t i = 0; i < updates.size(); ++i) {
+            order[positions[GetShardIndex(hashes[i])]++] = i;
+        }
+        for (size_t shard_index = 0; shard_index < shards_.size(); ++shard_index) {
+            if (shard_begins[shard_index] == shard_begins[shard_index + 1]) {
+                continue;
+            }
+            Shard& shard = shards_[shard_index];
+            std::lock_guard guard(shard.mutex);
+            for (size_t i = shard_begins[shard_index]; i < shard_begins[shard_index + 1]; ++i) {
+                const auto& [key, update] = updates[order[i]];
+                function(FindOrInsert(shard, key, hashes[order[i]]), update);
+            }
+        }
+    }
+
+    std::optional<Value> Find(const Key& key) const {
+        const size_t hash = GetHash(key);
+        const Shard& shard = GetShard(hash);
+        std::lock_guard guard(shard.mutex);
+        if (shard.slots.empty()) {
+            return std::nullopt;
+        }
+        const size_t slot = FindSlot(shard, key, hash);
+        if (!shard.slots[slot]) {
+            return std::nullopt;
+        }
+        return shard.slots[slot]->second;
+    }
 
-    Access operator[](const Key& key){
-        auto index = static_cast<uint64_t>(key) % count_;
-        return Access(mutexes_[index], storage_[index], key);
+    // Returns the number of erased elements, 0 or 1
+    size_t Erase(const Key& key) {
+        const size_t hash = GetHash(key);
+        Shard& shard = GetShard(hash);
+        std::lock_guard guard(shard.mutex);
+        if (shard.slots.empty()) {
+            return 0;
+        }
+        size_t slot = FindSlot(shard, key, hash);
+        if (!shard.slots[slot]) {
+            return 0;
+        }
+        // Backward-shift deletion: later elements of the probe run move up into the gap
+        // unless that would put them before their home slot, so no tombstones are needed
+        const size_t mask = shard.slots.size() - 1;
+        for (size_t next = (slot + 1) & mask; shard.slots[next]; next = (next + 1) & mask) {
+            const size_t home = GetSlotIndex(GetHash(shard.slots[next]->first), mask);
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                shard.slots[slot] = std::move(shard.slots[next]);
+                slot = next;
+            }
+        }
+        shard.slots[slot].reset();
+        --shard.size;
+        return 1;
     }
 
-    std::map<Key, Value> BuildOrdinaryMap(){
-        std::map<Key, Value> result;
-        for (size_t i = 0; i < storage_.size(); ++i){
-            std::lock_guard<std::mutex> guard(mutexes_[i]);
-            result.merge(storage_[i]);
-        }        
+    size_t Size() const {
+        size_t result = 0;
+        for (const Shard& shard : shards_) {
+            std::lock_guard guard(shard.mutex);
+            result += shard.size;
+        }
         return result;
     }
-    
-    void Erase(const Key& key){
-        auto index = static_cast<uint64_t>(key) % count_;
-        storage_[index].erase(key);
+
+    // Snapshot of all elements sorted by key. The shards are copied and the result sorted
+    // under the policy, all shards stay locked while they are copied
+    template <typename ExecutionPolicy>
+    std::vector<std::pair<Key, Value>> BuildSortedVector(ExecutionPolicy&& policy) const {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards_.size());
+        std::vector<size_t> offsets(shards_.size() + 1);
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            locks.emplace_back(shards_[i].mutex);
+            offsets[i + 1] = offsets[i] + shards_[i].size;
+        }
+        std::vector<std::pair<Key, Value>> result(offsets.back());
+        std::vector<size_t> shard_indexes(shards_.size());
+        std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+        std::for_each(policy, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard_index) {
+            auto out = result.begin() + offsets[shard_index];
+            for (const auto& slot : shards_[shard_index].slots) {
+                if (slot) {
+                    *out++ = *slot;
+                }
+            }
+        });
+        locks.clear();
+        std::sort(policy, result.begin(), result.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first < rhs.first;
+        });
+        return result;
+    }
+
+    std::vector<std::pair<Key, Value>> BuildSortedVector() const {
+        return BuildSortedVector(std::execution::seq);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() const {
+        const auto elements = BuildSortedVector();
+        return std::map<Key, Value>(elements.begin(), elements.end());
     }
 
 private:
-    std::vector<std::map<Key, Value>> storage_;
-    std::vector<std::mutex> mutexes_;
-    int count_ = 0;
+    // Aligned so that the mutexes of neighbouring shards do not share a cache line
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::vector<std::optional<std::pair<Key, Value>>> slots;  // power-of-two size
+        size_t size = 0;
+    };
+
+    static constexpr size_t MIN_SLOT_COUNT = 16;
+
+    std::vector<Shard> shards_;
+    Hash hash_;
+    KeyEqual key_equal_;
+
+    // Fibonacci hashing spreads identity hashes of integers over all bits: the top bits
+    // select the slot, the middle ones the shard
+    size_t GetHash(const Key& key) const {
+        return static_cast<size_t>(static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ull);
+    }
+
+    size_t GetShardIndex(size_t hash) const {
+        return (hash >> 24) % shards_.size();
+    }
+
+    Shard& GetShard(size_t hash) {
+        return shards_[GetShardIndex(hash)];
+    }
+
+    const Shard& GetShard(size_t hash) const {
+        return shards_[GetShardIndex(hash)];
+    }
+
+    static size_t GetSlotIndex(size_t hash, size_t mask) {
+        return (hash >> 40 | hash << 24) & mask;
+    }
+
+    // The slot holding the key or the empty slot ending its probe run; the shard must
+    // have slots
+    size_t FindSlot(const Shard& shard, const Key& key, size_t hash) const {
+        const size_t mask = shard.slots.size() - 1;
+        size_t slot = GetSlotIndex(hash, mask);
+        while (shard.slots[slot] && !key_equal_(shard.slots[slot]->first, key)) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    Value& FindOrInsert(Shard& shard, const Key& key, size_t hash) const {
+        // At most three quarters full, probe runs stay short
+        if ((shard.size + 1) * 4 > shard.slots.size() * 3) {
+            Grow(shard);
+        }
+        const size_t slot = FindSlot(shard, key, hash);
+        if (!shard.slots[slot]) {
+            shard.slots[slot].emplace(key, Value());
+            ++shard.size;
+        }
+        return shard.slots[slot]->second;
+    }
+
+    void Grow(Shard& shard) const {
+        std::vector<std::optional<std::pair<Key, Value>>> slots(std::max(MIN_SLOT_COUNT, shard.slots.size() * 2));
+        const size_t mask = slots.size() - 1;
+        for (auto& element : shard.slots) {
+            if (element) {
+                size_t slot = GetSlotIndex(GetHash(element->first), mask);
+                while (slots[slot]) {
+                    slot = (slot + 1) & mask;
+                }
+                slots[slot] = std::move(element);
+            }
+        }
+        shard.slots = std::move(slots);
+    }
 };
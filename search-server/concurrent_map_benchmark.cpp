@@ -0,0 +1,222 @@
+#include "concurrent_map_benchmark.h"
+#include "benchmark.h"
+#include "concurrent_map.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The previous ConcurrentMap, kept as the baseline: integer keys only, one std::map and
+// one mutex per sub-map, an export that merges the sub-maps into one tree
+template <typename Key, typename Value>
+class SubMapConcurrentMap {
+public:
+    struct Access {
+        Access(std::mutex& m, std::map<Key, Value>& sub_map, const Key& key) : guard(m), ref_to_value(sub_map[key]) {
+        }
+
+        std::lock_guard<std::mutex> guard;
+        Value& ref_to_value;
+    };
+
+    explicit SubMapConcurrentMap(size_t bucket_count) : storage_(bucket_count), mutexes_(bucket_count) {
+    }
+
+    Access operator[](const Key& key) {
+        const auto index = static_cast<uint64_t>(key) % storage_.size();
+        return Access(mutexes_[index], storage_[index], key);
+    }
+
+    std::map<Key, Value> BuildOrdinaryMap() {
+        std::map<Key, Value> result;
+        for (size_t i = 0; i < storage_.size(); ++i) {
+            std::lock_guard<std::mutex> guard(mutexes_[i]);
+            result.merge(storage_[i]);
+        }
+        return result;
+    }
+
+private:
+    std::vector<std::map<Key, Value>> storage_;
+    std::vector<std::mutex> mutexes_;
+};
+
+// Key sequences of all threads, drawn up front so that sampling is not timed
+std::vector<std::vector<int>> GenerateKeys(const ConcurrentMapBenchmarkConfig& config, int thread_count) {
+    const ZipfDistribution distribution(config.key_count, config.zipf_exponent);
+    // Ranks are scattered over the key space, otherwise the hot keys would be neighbours
+    std::vector<int> keys(config.key_count);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::mt19937 generator(config.seed);
+    std::shuffle(keys.begin(), keys.end(), generator);
+    std::vector<std::vector<int>> result(thread_count);
+    for (auto& thread_keys : result) {
+        thread_keys.reserve(config.operations_per_thread);
+        for (int i = 0; i < config.operations_per_thread; ++i) {
+            thread_keys.push_back(keys[distribution(generator)]);
+        }
+    }
+    return result;
+}
+
+// Runs work(thread_index) on every thread at once; returns the wall time in seconds
+template <typename Work>
+double RunThreads(int thread_count, Work work) {
+    std::atomic<int> ready = 0;
+    std::atomic<bool> start = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&, i] {
+            ++ready;
+            while (!start) {
+                std::this_thread::yield();
+            }
+            work(i);
+        });
+    }
+    while (ready < thread_count) {
+        std::this_thread::yield();
+    }
+    const auto begin = Clock::now();
+    start = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+template <typename Map>
+ConcurrentMapRunResult RunIncrements(const std::string& implementation, const ConcurrentMapBenchmarkConfig& config,
+                                     const std::vector<std::vector<int>>& keys) {
+    ConcurrentMapRunResult result;
+    result.implementation = implementation;
+    result.thread_count = static_cast<int>(keys.size());
+    Map map(config.shard_count);
+    const double seconds = RunThreads(result.thread_count, [&](int thread_index) {
+        for (const int key : keys[thread_index]) {
+            ++map[key].ref_to_value;
+        }
+    });
+    result.operations_per_second = seconds > 0 ? keys.size() * config.operations_per_thread / seconds : 0;
+
+    const auto export_start = Clock::now();
+    if constexpr (std::is_same_v<Map, SubMapConcurrentMap<int, uint64_t>>) {
+        for (const auto& [key, count] : map.BuildOrdinaryMap()) {
+            result.total_count += count;
+        }
+    } else {
+        for (const auto& [key, count] : map.BuildSortedVector(std::execution::par)) {
+            result.total_count += count;
+        }
+    }
+    result.export_seconds = std::chrono::duration<double>(Clock::now() - export_start).count();
+    return result;
+}
+
+ConcurrentMapRunResult RunBatchedIncrements(const ConcurrentMapBenchmarkConfig& config, const std::vector<std::vector<int>>& keys) {
+    ConcurrentMapRunResult result;
+    result.implementation = "striped_batch";
+    result.thread_count = static_cast<int>(keys.size());
+    ConcurrentMap<int, uint64_t> map(config.shard_count);
+    const double seconds = RunThreads(result.thread_count, [&](int thread_index) {
+        std::vector<std::pair<int, uint64_t>> batch;
+        batch.reserve(config.batch_size);
+        for (const int key : keys[thread_index]) {
+            batch.emplace_back(key, 1);
+            if (batch.size() == static_cast<size_t>(config.batch_size)) {
+                map.UpdateBatch(batch, [](uint64_t& count, uint64_t increment) { count += increment; });
+                batch.clear();
+            }
+        }
+        map.UpdateBatch(batch, [](uint64_t& count, uint64_t increment) { count += increment; });
+    });
+    result.operations_per_second = seconds > 0 ? keys.size() * config.operations_per_thread / seconds : 0;
+
+    const auto export_start = Clock::now();
+    for (const auto& [key, count] : map.BuildSortedVector(std::execution::par)) {
+        result.total_count += count;
+    }
+    result.export_seconds = std::chrono::duration<double>(Clock::now() - export_start).count();
+    return result;
+}
+
+}  // namespace
+
+ConcurrentMapBenchmarkReport RunConcurrentMapBenchmark(const ConcurrentMapBenchmarkConfig& config) {
+    ConcurrentMapBenchmarkReport report;
+    report.config = config;
+    for (const int thread_count : config.thread_counts) {
+        const auto keys = GenerateKeys(config, thread_count);
+        report.runs.push_back(RunIncrements<SubMapConcurrentMap<int, uint64_t>>("sub_maps", config, keys));
+        report.runs.push_back(RunIncrements<ConcurrentMap<int, uint64_t>>("striped", config, keys));
+        report.runs.push_back(RunBatchedIncrements(config, keys));
+    }
+    return report;
+}
+
+void PrintConcurrentMapBenchmarkJson(std::ostream& out, const ConcurrentMapBenchmarkReport& report) {
+    const auto& config = report.config;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"config\": {\"seed\": " << config.seed << ", \"thread_counts\": [";
+    for (size_t i = 0; i < config.thread_counts.size(); ++i) {
+        out << (i == 0 ? "" : ", ") << config.thread_counts[i];
+    }
+    out << "], \"key_count\": " << config.key_count
+        << ", \"operations_per_thread\": " << config.operations_per_thread
+        << ", \"shard_count\": " << config.shard_count
+        << ", \"zipf_exponent\": " << config.zipf_exponent
+        << ", \"batch_size\": " << config.batch_size << "},\n";
+    out << "  \"runs\": [";
+    bool first = true;
+    for (const auto& run : report.runs) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\"implementation\": \"" << run.implementation << "\", \"threads\": " << run.thread_count
+            << ", \"operations_per_second\": " << run.operations_per_second
+            << ", \"export_seconds\": " << run.export_seconds
+            << ", \"total_count\": " << run.total_count << "}";
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+ConcurrentMapBenchmarkConfig ParseConcurrentMapBenchmarkConfig(const std::vector<std::string_view>& args) {
+    ConcurrentMapBenchmarkConfig config;
+    for (const std::string_view arg : args) {
+        const auto [key, value] = SplitOption(arg);
+        if (key == "seed") {
+            config.seed = std::stoul(value);
+        } else if (key == "thread_counts") {
+            config.thread_counts.clear();
+            for (const std::string& count : SplitList(value)) {
+                config.thread_counts.push_back(std::stoi(count));
+            }
+        } else if (key == "key_count") {
+            config.key_count = std::stoi(value);
+        } else if (key == "operations_per_thread") {
+            config.operations_per_thread = std::stoi(value);
+        } else if (key == "shard_count") {
+            config.shard_count = std::stoi(value);
+        } else if (key == "zipf_exponent") {
+            config.zipf_exponent = std::stod(value);
+        } else if (key == "batch_size") {
+            config.batch_size = std::stoi(value);
+        } else {
+            throw std::invalid_argument("Unknown concurrent map benchmark option " + std::string(key));
+        }
+    }
+    if (config.thread_counts.empty() || std::any_of(config.thread_counts.begin(), config.thread_counts.end(), [](int count) { return count < 1; })) {
+        throw std::invalid_argument("Thread counts must be positive");
+    }
+    if (config.key_count < 1 || config.operations_per_thread < 0 || config.shard_count < 1 || config.batch_size < 1) {
+        throw std::invalid_argument("Invalid key_count, operations_per_thread, shard_count or batch_size");
+    }
+    return config;
+}
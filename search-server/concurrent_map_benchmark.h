@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Contention benchmark of ConcurrentMap against the std::map sub-maps it replaced: every
+// thread increments counters of keys drawn from a Zipf distribution, the way the ingest
+// pipeline counts per document, then the map is exported sorted.
+struct ConcurrentMapBenchmarkConfig {
+    uint32_t seed = 42;
+    std::vector<int> thread_counts = {1, 2, 4, 8};
+    int key_count = 100'000;             // distinct keys the operations draw from
+    int operations_per_thread = 1'000'000;
+    int shard_count = 16;                // sub-maps of the old map, shards of the new one
+    double zipf_exponent = 0;            // key skew, 0 is uniform; skewed keys contend on few shards
+    int batch_size = 256;                // increments per UpdateBatch call of the batched run
+};
+
+struct ConcurrentMapRunResult {
+    std::string implementation;          // "sub_maps", "striped" or "striped_batch"
+    int thread_count = 0;
+    double operations_per_second = 0;
+    double export_seconds = 0;           // BuildOrdinaryMap of the old map, BuildSortedVector(par) of the new one
+    uint64_t total_count = 0;            // sum of all counters, equals the operations performed
+};
+
+struct ConcurrentMapBenchmarkReport {
+    ConcurrentMapBenchmarkConfig config;
+    std::vector<ConcurrentMapRunResult> runs;
+};
+
+ConcurrentMapBenchmarkReport RunConcurrentMapBenchmark(const ConcurrentMapBenchmarkConfig& config);
+
+void PrintConcurrentMapBenchmarkJson(std::ostream& out, const ConcurrentMapBenchmarkReport& report);
+
+// Parses key=value arguments, the keys are the field names of ConcurrentMapBenchmarkConfig
+// with thread_counts a comma-separated list
+ConcurrentMapBenchmarkConfig ParseConcurrentMapBenchmarkConfig(const std::vector<std::string_view>& args);
@@ -0,0 +1,65 @@
+#include "impact_index.h"
+#include <algorithm>
+#include <cmath>
+
+void ImpactIndex::Add(std::string_view word, int document_id, double term_freq) {
+    auto& segments = word_to_segments_[word];
+    const auto [segment_it, is_new] = segments.try_emplace(GetBucket(term_freq));
+    Segment& segment = segment_it->second;
+    if (is_new) {
+        ++segment_count_;
+    }
+    segment_bytes_ -= GetVectorHeapSize(segment);
+    segment.emplace_back(document_id, term_freq);
+    segment_bytes_ += GetVectorHeapSize(segment);
+    ++posting_count_;
+}
+
+void ImpactIndex::Remove(std::string_view word, int document_id, double term_freq) {
+    const auto word_it = word_to_segments_.find(word);
+    if (word_it == word_to_segments_.end()) {
+        return;
+    }
+    const auto segment_it = word_it->second.find(GetBucket(term_freq));
+    if (segment_it == word_it->second.end()) {
+        return;
+    }
+    Segment& segment = segment_it->second;
+    const auto it = std::find_if(segment.begin(), segment.end(),
+                                 [document_id](const auto& posting) { return posting.first == document_id; });
+    if (it != segment.end()) {
+        // Order inside a segment does not matter
+        *it = segment.back();
+        segment.pop_back();
+        --posting_count_;
+    }
+    if (segment.empty()) {
+        segment_bytes_ -= GetVectorHeapSize(segment);
+        --segment_count_;
+        word_it->second.erase(segment_it);
+    }
+}
+
+const std::map<int, ImpactIndex::Segment>* ImpactIndex::GetSegments(std::string_view word) const {
+    const auto it = word_to_segments_.find(word);
+    return it == word_to_segments_.end() ? nullptr : &it->second;
+}
+
+StructureMemory ImpactIndex::GetMemoryUsage() const {
+    return {posting_count_,
+            word_to_segments_.size() * GetTreeNodeSize<decltype(word_to_segments_)>()
+                + segment_count_ * GetTreeNodeSize<std::map<int, Segment>>() + segment_bytes_};
+}
+
+int ImpactIndex::GetBucket(double term_freq) {
+    if (term_freq >= 1.0) {
+        return 0;
+    }
+    const int bucket = static_cast<int>(-std::log2(term_freq) * 4.0);
+    return std::clamp(bucket, 0, BUCKET_COUNT - 1);
+}
+
+double ImpactIndex::GetBucketMaxTermFreq(int bucket) {
+    // Slightly above 2^(-bucket/4) to absorb rounding in GetBucket
+    return std::exp2(-bucket / 4.0) * (1.0 + 1e-9);
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "memory_stats.h"
+#include <map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Postings of every term split into segments by quantised term frequency. Segments
+// of a term are ordered from the highest impact down, so a query can visit the most
+// valuable postings first. The exact term frequency is kept next to each document id.
+class ImpactIndex {
+public:
+    using Segment = std::vector<std::pair<int, double>>;
+
+    // Bucket 0 holds term_freq in (2^(-1/4), 1], each next bucket a quarter octave lower
+    static constexpr int BUCKET_COUNT = 64;
+
+    void Add(std::string_view word, int document_id, double term_freq);
+
+    void Remove(std::string_view word, int document_id, double term_freq);
+
+    // Segments keyed by bucket, i.e. in decreasing impact order; nullptr for unknown words
+    const std::map<int, Segment>* GetSegments(std::string_view word) const;
+
+    static int GetBucket(double term_freq);
+
+    // Upper bound of the term frequencies falling into the bucket
+    static double GetBucketMaxTermFreq(int bucket);
+
+    StructureMemory GetMemoryUsage() const;
+
+private:
+    std::map<std::string_view, std::map<int, Segment>> word_to_segments_;
+    // Maintained by Add and Remove, so that GetMemoryUsage does not walk the index
+    size_t posting_count_ = 0;
+    size_t segment_count_ = 0;
+    size_t segment_bytes_ = 0;
+};
@@ -0,0 +1,87 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr uint64_t SUB_BUCKET_COUNT = uint64_t{1} << LatencyHistogram::SUB_BUCKET_BITS;
+constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (64 - LatencyHistogram::SUB_BUCKET_BITS + 1);
+
+int GetHighestBit(uint64_t value) {
+    int result = 0;
+    while (value >>= 1) {
+        ++result;
+    }
+    return result;
+}
+
+}  // namespace
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+    const int shift = GetHighestBit(value) - SUB_BUCKET_BITS;
+    return SUB_BUCKET_COUNT * (shift + 1) + ((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int shift = static_cast<int>(index / SUB_BUCKET_COUNT) - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    return ((SUB_BUCKET_COUNT + sub_bucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(uint64_t value_ns) {
+    if (counts_.empty()) {
+        counts_.resize(BUCKET_COUNT);
+    }
+    ++counts_[GetBucketIndex(value_ns)];
+    ++count_;
+    max_ = std::max(max_, value_ns);
+    sum_ += value_ns;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    if (other.counts_.empty()) {
+        return;
+    }
+    if (counts_.empty()) {
+        counts_.resize(BUCKET_COUNT);
+    }
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+    return count_;
+}
+
+uint64_t LatencyHistogram::GetMax() const {
+    return max_;
+}
+
+double LatencyHistogram::GetMean() const {
+    return count_ == 0 ? 0.0 : sum_ / count_;
+}
+
+uint64_t LatencyHistogram::GetQuantile(double quantile) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return std::min(GetBucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Log-linear histogram of latencies in nanoseconds: values below 2^SUB_BUCKET_BITS are
+// exact, every larger power of two is split into 2^SUB_BUCKET_BITS buckets, so values are
+// kept to about 3% in a fixed amount of memory however long the tail is. Not thread-safe,
+// record into one histogram per thread and merge them.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+
+    void Record(uint64_t value_ns);
+
+    void Merge(const LatencyHistogram& other);
+
+    uint64_t GetCount() const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+
+    // Upper bound of the bucket holding the quantile (0..1), never above the maximum
+    uint64_t GetQuantile(double quantile) const;
+
+private:
+    static size_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketUpperBound(size_t index);
+
+    std::vector<uint64_t> counts_;  // allocated on the first Record
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+    double sum_ = 0;
+};
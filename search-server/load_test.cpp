@@ -0,0 +1,377 @@
+#include "load_test.h"
+#include "latency_histogram.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <shared_mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char* const REQUEST_KIND_NAMES[LOAD_REQUEST_KIND_COUNT] = {"query", "add", "remove"};
+
+struct ScheduledRequest {
+    uint64_t arrival_ns;  // from the start of the step
+    LoadRequestKind kind;
+    uint32_t index;  // into the queries, the added documents or the ids to remove
+};
+
+using KindHistograms = std::array<LatencyHistogram, LOAD_REQUEST_KIND_COUNT>;
+
+struct ClientStats {
+    KindHistograms latency;
+    KindHistograms service_time;
+    std::vector<KindHistograms> intervals;
+    uint64_t completed = 0;
+    double total_relevance = 0;
+};
+
+// Everything the clients of one step share. SearchServer is not thread-safe for writers,
+// so queries hold the mutex shared and AddDocument/RemoveDocument exclusively; the wait
+// for it is part of the measured latency, as it would be in a server embedding the index.
+struct StepContext {
+    SearchServer& search_server;
+    std::shared_mutex index_mutex;
+    const std::vector<ScheduledRequest>& schedule;
+    const std::vector<std::string>& queries;
+    const std::vector<std::string>& added_documents;
+    const std::vector<int>& ids_to_remove;
+    int first_added_id;
+    std::atomic<size_t> next_request{0};
+    Clock::time_point start;
+    Clock::time_point deadline;  // no request is started after it
+    uint64_t interval_ns;
+};
+
+std::vector<std::string> ReadQueryLog(const std::string& path) {
+    std::ifstream input(path);
+    if (!input) {
+        throw std::invalid_argument("Cannot read query log " + path);
+    }
+    std::vector<std::string> result;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty()) {
+            result.push_back(std::move(line));
+        }
+    }
+    if (result.empty()) {
+        throw std::invalid_argument("Query log " + path + " is empty");
+    }
+    return result;
+}
+
+std::vector<ScheduledRequest> MakeSchedule(const LoadTestConfig& config, double arrival_rate, size_t query_count,
+                                           size_t removable_count, std::mt19937& generator) {
+    std::vector<ScheduledRequest> result;
+    std::exponential_distribution<double> gap(arrival_rate);
+    std::uniform_real_distribution<double> kind(0, 1);
+    uint32_t queries = 0;
+    uint32_t adds = 0;
+    uint32_t removes = 0;
+    double arrival_seconds = 0;
+    for (size_t i = 0;; ++i) {
+        arrival_seconds = config.poisson_arrivals ? arrival_seconds + gap(generator) : i / arrival_rate;
+        if (arrival_seconds >= config.duration_seconds) {
+            break;
+        }
+        const double draw = kind(generator);
+        ScheduledRequest request{static_cast<uint64_t>(arrival_seconds * 1e9), LoadRequestKind::QUERY, 0};
+        if (draw < config.add_ratio) {
+            request.kind = LoadRequestKind::ADD;
+            request.index = adds++;
+        } else if (draw < config.add_ratio + config.remove_ratio && removes < removable_count) {
+            request.kind = LoadRequestKind::REMOVE;
+            request.index = removes++;
+        } else {
+            // The log is replayed in order and wraps around
+            request.index = queries++ % query_count;
+        }
+        result.push_back(request);
+    }
+    return result;
+}
+
+template <typename ExecutionPolicy>
+void RunClient(ExecutionPolicy&& policy, StepContext& context, ClientStats& stats) {
+    std::vector<Document> documents;
+    while (true) {
+        const size_t i = context.next_request.fetch_add(1, std::memory_order_relaxed);
+        if (i >= context.schedule.size() || Clock::now() > context.deadline) {
+            return;
+        }
+        const ScheduledRequest& request = context.schedule[i];
+        const Clock::time_point arrival = context.start + std::chrono::nanoseconds(request.arrival_ns);
+        std::this_thread::sleep_until(arrival);
+        const auto begin = Clock::now();
+        switch (request.kind) {
+        case LoadRequestKind::QUERY: {
+            std::shared_lock lock(context.index_mutex);
+            context.search_server.FindTopDocumentsPage(policy, context.queries[request.index], DocumentStatus::ACTUAL,
+                                                       0, MAX_RESULT_DOCUMENT_COUNT, documents);
+            for (const Document& document : documents) {
+                stats.total_relevance += document.relevance;
+            }
+            break;
+        }
+        case LoadRequestKind::ADD: {
+            std::unique_lock lock(context.index_mutex);
+            context.search_server.AddDocument(context.first_added_id + request.index, context.added_documents[request.index],
+                                              DocumentStatus::ACTUAL, {1, 2, 3});
+            break;
+        }
+        case LoadRequestKind::REMOVE: {
+            std::unique_lock lock(context.index_mutex);
+            context.search_server.RemoveDocument(policy, context.ids_to_remove[request.index]);
+            break;
+        }
+        }
+        const auto end = Clock::now();
+        const size_t kind = static_cast<size_t>(request.kind);
+        const uint64_t latency_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - arrival).count();
+        stats.latency[kind].Record(latency_ns);
+        stats.service_time[kind].Record(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+        const size_t interval = std::chrono::duration_cast<std::chrono::nanoseconds>(end - context.start).count() / context.interval_ns;
+        if (interval >= stats.intervals.size()) {
+            stats.intervals.resize(interval + 1);
+        }
+        stats.intervals[interval][kind].Record(latency_ns);
+        ++stats.completed;
+    }
+}
+
+template <typename ExecutionPolicy>
+LoadStepResult RunStep(ExecutionPolicy&& policy, const LoadTestConfig& config, double arrival_rate,
+                       const std::string& stop_words, const std::vector<std::string>& documents,
+                       const std::vector<std::string>& queries) {
+    LoadStepResult result;
+    result.arrival_rate = arrival_rate;
+
+    std::mt19937 generator(config.corpus.seed);
+    std::vector<int> ids_to_remove(documents.size());
+    std::iota(ids_to_remove.begin(), ids_to_remove.end(), 0);
+    std::shuffle(ids_to_remove.begin(), ids_to_remove.end(), generator);
+    const auto schedule = MakeSchedule(config, arrival_rate, queries.size(), ids_to_remove.size(), generator);
+    result.scheduled = schedule.size();
+
+    const size_t add_count = std::count_if(schedule.begin(), schedule.end(), [](const ScheduledRequest& request) {
+        return request.kind == LoadRequestKind::ADD;
+    });
+    BenchmarkConfig added_corpus = config.corpus;
+    added_corpus.seed = config.corpus.seed + 1;
+    added_corpus.document_count = static_cast<int>(add_count);
+    const auto added_documents = CorpusGenerator(added_corpus).GenerateDocuments();
+
+    SearchServerOptions options;
+    options.store_positions = config.corpus.store_positions;
+    options.lean_index = config.corpus.lean_index;
+    options.champion_list_size = config.corpus.champion_list_size;
+    options.champion_min_postings = config.corpus.champion_min_postings;
+    SearchServer search_server(stop_words, options);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    // A short lead so that every client is waiting when the first request is due
+    const Clock::time_point start = Clock::now() + std::chrono::milliseconds(10);
+    const Clock::time_point deadline = start + std::chrono::nanoseconds(static_cast<uint64_t>((config.duration_seconds + config.drain_seconds) * 1e9));
+    StepContext context{search_server, {}, schedule, queries, added_documents, ids_to_remove, static_cast<int>(documents.size()),
+                        {0}, start, deadline, static_cast<uint64_t>(config.report_interval_seconds * 1e9)};
+    std::vector<ClientStats> clients(config.client_count);
+    {
+        std::vector<std::thread> threads;
+        for (ClientStats& stats : clients) {
+            threads.emplace_back([&policy, &context, &stats] { RunClient(policy, context, stats); });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    const double elapsed_seconds = std::chrono::duration<double>(Clock::now() - context.start).count();
+
+    KindHistograms latency;
+    KindHistograms service_time;
+    std::vector<KindHistograms> intervals;
+    uint64_t completed = 0;
+    for (const ClientStats& stats : clients) {
+        for (size_t kind = 0; kind < LOAD_REQUEST_KIND_COUNT; ++kind) {
+            latency[kind].Merge(stats.latency[kind]);
+            service_time[kind].Merge(stats.service_time[kind]);
+        }
+        if (stats.intervals.size() > intervals.size()) {
+            intervals.resize(stats.intervals.size());
+        }
+        for (size_t i = 0; i < stats.intervals.size(); ++i) {
+            for (size_t kind = 0; kind < LOAD_REQUEST_KIND_COUNT; ++kind) {
+                intervals[i][kind].Merge(stats.intervals[i][kind]);
+            }
+        }
+        completed += stats.completed;
+        result.total_relevance += stats.total_relevance;
+    }
+    for (size_t kind = 0; kind < LOAD_REQUEST_KIND_COUNT; ++kind) {
+        result.latency[kind] = SummarizeHistogram(latency[kind]);
+        result.service_time[kind] = SummarizeHistogram(service_time[kind]);
+    }
+    for (size_t i = 0; i < intervals.size(); ++i) {
+        LoadInterval& interval = result.intervals.emplace_back();
+        interval.start_seconds = i * config.report_interval_seconds;
+        for (size_t kind = 0; kind < LOAD_REQUEST_KIND_COUNT; ++kind) {
+            interval.latency[kind] = SummarizeHistogram(intervals[i][kind]);
+        }
+    }
+    result.unfinished = result.scheduled - completed;
+    result.achieved_rate = completed / std::max(elapsed_seconds, config.duration_seconds);
+    // A server that keeps up finishes close to the end of the schedule, one that does not
+    // drags the queue behind it and completes noticeably fewer requests per second
+    result.saturated = result.unfinished > 0 || result.achieved_rate < 0.95 * result.scheduled / config.duration_seconds;
+    return result;
+}
+
+void PrintKindLatenciesJson(std::ostream& out, const LatencySummary (&latency)[LOAD_REQUEST_KIND_COUNT]) {
+    for (size_t kind = 0; kind < LOAD_REQUEST_KIND_COUNT; ++kind) {
+        out << (kind == 0 ? "" : ", ") << "\"" << REQUEST_KIND_NAMES[kind] << "\": ";
+        PrintLatencyJson(out, latency[kind]);
+    }
+}
+
+}  // namespace
+
+LoadTestReport RunLoadTest(const LoadTestConfig& config) {
+    LoadTestReport report;
+    report.config = config;
+
+    CorpusGenerator corpus(config.corpus);
+    const auto documents = corpus.GenerateDocuments();
+    const auto queries = config.query_log_path.empty() ? corpus.GenerateQueries() : ReadQueryLog(config.query_log_path);
+    if (queries.empty()) {
+        throw std::invalid_argument("Load test needs at least one query");
+    }
+    const std::string stop_words = corpus.GetStopWords();
+
+    for (const std::string& policy : config.policies) {
+        for (const double arrival_rate : config.arrival_rates) {
+            LoadStepResult step = policy == "par"
+                ? RunStep(std::execution::par, config, arrival_rate, stop_words, documents, queries)
+                : RunStep(std::execution::seq, config, arrival_rate, stop_words, documents, queries);
+            step.policy = policy;
+            report.steps.push_back(std::move(step));
+        }
+    }
+    return report;
+}
+
+void PrintLoadTestJson(std::ostream& out, const LoadTestReport& report) {
+    const auto& config = report.config;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"config\": {\"query_log\": \"" << config.query_log_path << "\""
+        << ", \"arrivals\": \"" << (config.poisson_arrivals ? "poisson" : "fixed") << "\""
+        << ", \"clients\": " << config.client_count
+        << ", \"duration\": " << config.duration_seconds
+        << ", \"add_ratio\": " << config.add_ratio
+        << ", \"remove_ratio\": " << config.remove_ratio
+        << ", \"report_interval\": " << config.report_interval_seconds
+        << ", \"drain\": " << config.drain_seconds
+        << ", \"seed\": " << config.corpus.seed
+        << ", \"document_count\": " << config.corpus.document_count
+        << ", \"query_count\": " << config.corpus.query_count << "},\n";
+    out << "  \"steps\": [";
+    // Highest offered rate each policy kept up with
+    std::map<std::string, double> max_sustained_rate;
+    bool first = true;
+    for (const LoadStepResult& step : report.steps) {
+        max_sustained_rate.emplace(step.policy, 0.0);
+        if (!step.saturated) {
+            max_sustained_rate[step.policy] = std::max(max_sustained_rate[step.policy], step.arrival_rate);
+        }
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\"policy\": \"" << step.policy << "\", \"arrival_rate\": " << step.arrival_rate
+            << ", \"achieved_rate\": " << step.achieved_rate
+            << ", \"scheduled\": " << step.scheduled
+            << ", \"unfinished\": " << step.unfinished
+            << ", \"saturated\": " << (step.saturated ? "true" : "false")
+            << ", \"total_relevance\": " << step.total_relevance
+            << ",\n     \"latency\": {";
+        PrintKindLatenciesJson(out, step.latency);
+        out << "},\n     \"service_time\": {";
+        PrintKindLatenciesJson(out, step.service_time);
+        out << "},\n     \"intervals\": [";
+        for (size_t i = 0; i < step.intervals.size(); ++i) {
+            out << (i == 0 ? "\n" : ",\n") << "       {\"start_seconds\": " << step.intervals[i].start_seconds << ", ";
+            PrintKindLatenciesJson(out, step.intervals[i].latency);
+            out << "}";
+        }
+        out << "]}";
+    }
+    out << "\n  ],\n  \"max_sustained_rate\": {";
+    first = true;
+    for (const auto& [policy, rate] : max_sustained_rate) {
+        out << (first ? "" : ", ") << "\"" << policy << "\": " << rate;
+        first = false;
+    }
+    out << "}\n}" << std::endl;
+}
+
+LoadTestConfig ParseLoadTestConfig(const std::vector<std::string_view>& args) {
+    LoadTestConfig config;
+    std::vector<std::string_view> corpus_args;
+    for (const std::string_view arg : args) {
+        const auto [key, value] = SplitOption(arg);
+        if (key == "query_log") {
+            config.query_log_path = value;
+        } else if (key == "policies") {
+            config.policies = SplitList(value);
+        } else if (key == "arrival_rates") {
+            config.arrival_rates.clear();
+            for (const std::string& rate : SplitList(value)) {
+                config.arrival_rates.push_back(std::stod(rate));
+            }
+        } else if (key == "arrivals") {
+            if (value != "poisson" && value != "fixed") {
+                throw std::invalid_argument("Arrivals are poisson or fixed, got " + value);
+            }
+            config.poisson_arrivals = value == "poisson";
+        } else if (key == "clients") {
+            config.client_count = std::stoi(value);
+        } else if (key == "duration") {
+            config.duration_seconds = std::stod(value);
+        } else if (key == "add_ratio") {
+            config.add_ratio = std::stod(value);
+        } else if (key == "remove_ratio") {
+            config.remove_ratio = std::stod(value);
+        } else if (key == "report_interval") {
+            config.report_interval_seconds = std::stod(value);
+        } else if (key == "drain") {
+            config.drain_seconds = std::stod(value);
+        } else {
+            corpus_args.push_back(arg);
+        }
+    }
+    config.corpus = ParseBenchmarkConfig(corpus_args);
+
+    for (const std::string& policy : config.policies) {
+        if (policy != "seq" && policy != "par") {
+            throw std::invalid_argument("Unknown execution policy " + policy);
+        }
+    }
+    if (config.arrival_rates.empty() || std::any_of(config.arrival_rates.begin(), config.arrival_rates.end(), [](double rate) { return rate <= 0; })) {
+        throw std::invalid_argument("Arrival rates must be positive");
+    }
+    if (config.client_count < 1 || config.duration_seconds <= 0 || config.report_interval_seconds <= 0 || config.drain_seconds < 0) {
+        throw std::invalid_argument("Invalid clients, duration, report_interval or drain");
+    }
+    if (config.add_ratio < 0 || config.remove_ratio < 0 || config.add_ratio + config.remove_ratio > 1) {
+        throw std::invalid_argument("add_ratio and remove_ratio must be non-negative and sum to at most 1");
+    }
+    return config;
+}
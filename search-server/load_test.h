@@ -0,0 +1,64 @@
+#pragma once
+#include "benchmark.h"
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Open-loop load test: requests arrive on a schedule fixed in advance, whether or not
+// the server keeps up, and are served by a pool of client threads. Latency is measured
+// from the scheduled arrival, so time a request spends waiting for a busy client counts
+// (no coordinated omission); the service time from the actual start is reported as well.
+struct LoadTestConfig {
+    BenchmarkConfig corpus;              // corpus and generated queries
+    std::string query_log_path;          // one query per line, replayed in order; generated queries if empty
+    std::vector<std::string> policies = {"seq", "par"};
+    std::vector<double> arrival_rates = {1000};  // requests per second over all clients, one step each
+    bool poisson_arrivals = true;        // exponential gaps, otherwise evenly spaced
+    int client_count = 4;
+    double duration_seconds = 5;         // of the schedule of every step
+    double add_ratio = 0;                // shares of AddDocument and RemoveDocument requests
+    double remove_ratio = 0;
+    double report_interval_seconds = 1;
+    // A step stops taking requests this long after its schedule ends, the rest count as unfinished
+    double drain_seconds = 5;
+};
+
+enum class LoadRequestKind {
+    QUERY,
+    ADD,
+    REMOVE,
+};
+
+constexpr size_t LOAD_REQUEST_KIND_COUNT = 3;
+
+struct LoadInterval {
+    double start_seconds = 0;
+    LatencySummary latency[LOAD_REQUEST_KIND_COUNT];  // indexed by LoadRequestKind
+};
+
+struct LoadStepResult {
+    std::string policy;
+    double arrival_rate = 0;
+    double achieved_rate = 0;            // completed requests per second of the step
+    uint64_t scheduled = 0;
+    uint64_t unfinished = 0;
+    bool saturated = false;              // the server fell behind the schedule
+    double total_relevance = 0;
+    LatencySummary latency[LOAD_REQUEST_KIND_COUNT];       // from the scheduled arrival
+    LatencySummary service_time[LOAD_REQUEST_KIND_COUNT];  // from the actual start
+    std::vector<LoadInterval> intervals;  // by completion time
+};
+
+struct LoadTestReport {
+    LoadTestConfig config;
+    std::vector<LoadStepResult> steps;
+};
+
+LoadTestReport RunLoadTest(const LoadTestConfig& config);
+
+void PrintLoadTestJson(std::ostream& out, const LoadTestReport& report);
+
+// Load test keys plus all BenchmarkConfig keys for the corpus; lists are comma-separated,
+// e.g. policies=seq,par arrival_rates=500,1000,2000
+LoadTestConfig ParseLoadTestConfig(const std::vector<std::string_view>& args);
@@ -1,72 +1,32 @@
-#include "search_server.h"
-#include "log_duration.h"
-#include "process_queries.h"
-#include <execution>
+#include "benchmark.h"
+#include "concurrent_map_benchmark.h"
+#include "load_test.h"
 #include <iostream>
-#include <random>
-#include <string>
+#include <string_view>
 #include <vector>
 using namespace std;
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution('a', 'z')(generator));
-    }
-    return word;
-}
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
-    }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
-}
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
+
+// Usage: search-server [key=value ...], e.g. document_count=50000 zipf_exponent=1.1
+//        search-server load [key=value ...], e.g. load policies=seq,par arrival_rates=500,1000,2000
+//        search-server concurrent_map [key=value ...], e.g. concurrent_map thread_counts=1,8 zipf_exponent=1
+// Prints a JSON report to stdout, see BenchmarkConfig, LoadTestConfig and
+// ConcurrentMapBenchmarkConfig for the available keys.
+int main(int argc, char* argv[]) {
+    try {
+        if (argc > 1 && string_view(argv[1]) == "load") {
+            const LoadTestConfig config = ParseLoadTestConfig(vector<string_view>(argv + 2, argv + argc));
+            PrintLoadTestJson(cout, RunLoadTest(config));
+            return 0;
         }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
-    }
-    return query;
-}
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
-    vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
-    }
-    return queries;
-}
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(mark);
-    double total_relevance = 0;
-    for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
-            total_relevance += document.relevance;
+        if (argc > 1 && string_view(argv[1]) == "concurrent_map") {
+            const ConcurrentMapBenchmarkConfig config = ParseConcurrentMapBenchmarkConfig(vector<string_view>(argv + 2, argv + argc));
+            PrintConcurrentMapBenchmarkJson(cout, RunConcurrentMapBenchmark(config));
+            return 0;
         }
+        const BenchmarkConfig config = ParseBenchmarkConfig(vector<string_view>(argv + 1, argv + argc));
+        PrintBenchmarkJson(cout, RunBenchmark(config));
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
     }
-    cout << total_relevance << endl;
 }
-#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
-int main() {
-    mt19937 generator;
-    const auto dictionary = GenerateDictionary(generator, 1000, 10);
-    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
-    SearchServer search_server(dictionary[0]);
-    for (size_t i = 0; i < documents.size(); ++i) {
-        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
-    }
-    const auto queries = GenerateQueries(generator, dictionary, 100, 70);
-    TEST(seq);
-    TEST(par);
-} 
\ No newline at end of file
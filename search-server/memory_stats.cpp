@@ -0,0 +1,68 @@
+#include "memory_stats.h"
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+void PrintStructureJson(std::ostream& out, const char* name, const StructureMemory& memory) {
+    out << "\"" << name << "\": {\"entries\": " << memory.entries << ", \"bytes\": " << memory.bytes << "}";
+}
+
+}  // namespace
+
+size_t MemoryStats::GetIndexBytes() const {
+    return word_to_document_freqs.bytes + document_id_to_word_frequency.bytes + documents.bytes + document_ids.bytes
+           + document_text.bytes + word_to_document_positions.bytes + impact_index.bytes + champion_lists.bytes + term_dictionary.bytes
+           + cold_posting_directory.bytes + document_term_ids.bytes + term_storage.bytes;
+}
+
+double MemoryStats::GetHeapFragmentation() const {
+    const size_t heap = heap_in_use_bytes + heap_free_bytes;
+    return heap == 0 ? 0.0 : heap_free_bytes * 1.0 / heap;
+}
+
+void ReadHeapStats(MemoryStats& stats) {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    const struct mallinfo2 info = mallinfo2();
+    stats.heap_in_use_bytes = info.uordblks;
+    stats.heap_free_bytes = info.fordblks;
+    stats.heap_mapped_bytes = info.hblkhd;
+#else
+    stats.heap_in_use_bytes = 0;
+    stats.heap_free_bytes = 0;
+    stats.heap_mapped_bytes = 0;
+#endif
+}
+
+void PrintMemoryStatsJson(std::ostream& out, const MemoryStats& stats) {
+    out << "{";
+    PrintStructureJson(out, "word_to_document_freqs", stats.word_to_document_freqs);
+    out << ", ";
+    PrintStructureJson(out, "document_id_to_word_frequency", stats.document_id_to_word_frequency);
+    out << ", ";
+    PrintStructureJson(out, "documents", stats.documents);
+    out << ", ";
+    PrintStructureJson(out, "document_ids", stats.document_ids);
+    out << ", ";
+    PrintStructureJson(out, "document_text", stats.document_text);
+    out << ", ";
+    PrintStructureJson(out, "word_to_document_positions", stats.word_to_document_positions);
+    out << ", ";
+    PrintStructureJson(out, "impact_index", stats.impact_index);
+    out << ", ";
+    PrintStructureJson(out, "champion_lists", stats.champion_lists);
+    out << ", ";
+    PrintStructureJson(out, "term_dictionary", stats.term_dictionary);
+    out << ", ";
+    PrintStructureJson(out, "cold_posting_directory", stats.cold_posting_directory);
+    out << ", ";
+    PrintStructureJson(out, "document_term_ids", stats.document_term_ids);
+    out << ", ";
+    PrintStructureJson(out, "term_storage", stats.term_storage);
+    out << ", \"index_bytes\": " << stats.GetIndexBytes()
+        << ", \"heap_in_use_bytes\": " << stats.heap_in_use_bytes
+        << ", \"heap_free_bytes\": " << stats.heap_free_bytes
+        << ", \"heap_mapped_bytes\": " << stats.heap_mapped_bytes
+        << ", \"heap_fragmentation\": " << stats.GetHeapFragmentation() << "}";
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// Heap footprint of one index structure. Bytes are what the structure requests from
+// malloc, rounded the way glibc rounds chunks and including the chunk headers, so
+// the per-node overhead of the tree containers is visible.
+struct StructureMemory {
+    size_t entries = 0;
+    size_t bytes = 0;
+};
+
+struct MemoryStats {
+    StructureMemory word_to_document_freqs;       // entries are postings
+    StructureMemory document_id_to_word_frequency;  // entries are (document, word) pairs
+    StructureMemory documents;
+    StructureMemory document_ids;
+    StructureMemory document_text;
+    StructureMemory word_to_document_positions;
+    StructureMemory impact_index;
+    StructureMemory champion_lists;
+    StructureMemory term_dictionary;
+    StructureMemory cold_posting_directory;  // entries are cold lists, their postings are on disk
+    // lean_index only, instead of the forward index and the document texts
+    StructureMemory document_term_ids;  // entries are (document, term) pairs
+    StructureMemory term_storage;  // entries are terms
+
+    // Process-wide state of the C library allocator, zero where it is not available:
+    // bytes handed out, bytes free inside the heap and bytes in separately mapped blocks
+    size_t heap_in_use_bytes = 0;
+    size_t heap_free_bytes = 0;
+    size_t heap_mapped_bytes = 0;
+
+    size_t GetIndexBytes() const;
+
+    // Share of the non-mapped heap that is free but still held by the allocator
+    double GetHeapFragmentation() const;
+};
+
+// Fills the heap_* fields. The allocator walks its free lists for that, typically well
+// under a millisecond (the first call also merges the fast bins and takes longer)
+void ReadHeapStats(MemoryStats& stats);
+
+void PrintMemoryStatsJson(std::ostream& out, const MemoryStats& stats);
+
+// Size of the glibc chunk serving a request: 8 bytes of header, 16-byte granularity
+constexpr size_t GetMallocChunkSize(size_t size) {
+    return std::max<size_t>(32, (size + 8 + 15) / 16 * 16);
+}
+
+// A red-black tree node is the colour and three links followed by the value
+template <typename Container>
+constexpr size_t GetTreeNodeSize() {
+    return GetMallocChunkSize(4 * sizeof(void*) + sizeof(typename Container::value_type));
+}
+
+// Heap block of a string, zero while it fits into the small-string buffer
+inline size_t GetStringHeapSize(const std::string& str) {
+    static const size_t inline_capacity = std::string().capacity();
+    return str.capacity() > inline_capacity ? GetMallocChunkSize(str.capacity() + 1) : 0;
+}
+
+template <typename Vector>
+size_t GetVectorHeapSize(const Vector& vector) {
+    return vector.capacity() == 0 ? 0 : GetMallocChunkSize(vector.capacity() * sizeof(typename Vector::value_type));
+}
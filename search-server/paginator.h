@@ -1,78 +1,124 @@
 #pragma once
 #include <utility>
 #include <algorithm>
+#include <iterator>
 #include <vector>
 #include <iostream>
 
 template <typename Iterator>
 class IteratorRange {
    public:
-    IteratorRange(Iterator& first, Iterator& last){
+    IteratorRange(Iterator first, Iterator last){
         range_ = std::make_pair(first, last);
     }
-    
+
     Iterator begin() const {
         return range_.first;
     }
-        
+
     Iterator end() const {
         return range_.second;
     }
-        
+
     size_t size() const {
         return std::distance(range_.first, range_.second);
     }
-    
+
   private:
       std::pair<Iterator, Iterator> range_;
-    
+
 };
 
 
+// Pages are not materialised: each IteratorRange is built on dereference,
+// so paginating a huge range costs nothing until a page is actually visited.
 template <typename Iterator>
 class Paginator {
     public:
-     Paginator(const Iterator& range_begin, const Iterator& range_end, size_t& page_size){
-         auto it = range_begin;
-         while (it < range_end){
-                 auto it1 = it;
-                if (std::distance(it, range_end) > page_size){
-                    std::advance(it, page_size);
-                 }
-                 else {
-                    it = range_end;
-                 }
-                 IteratorRange range(it1, it);
-                 sections_.push_back(range);
-                 
-        }
+     class PageIterator {
+        public:
+         using iterator_category = std::forward_iterator_tag;
+         using value_type = IteratorRange<Iterator>;
+         using difference_type = std::ptrdiff_t;
+         using pointer = void;
+         using reference = IteratorRange<Iterator>;
+
+         PageIterator(Iterator current, Iterator range_end, size_t page_size)
+             : current_(current), range_end_(range_end), page_size_(page_size) {
+         }
+
+         IteratorRange<Iterator> operator*() const {
+             return IteratorRange<Iterator>(current_, NextPageBegin());
+         }
+
+         PageIterator& operator++(){
+             current_ = NextPageBegin();
+             return *this;
+         }
+
+         PageIterator operator++(int){
+             auto copy = *this;
+             ++*this;
+             return copy;
+         }
+
+         bool operator==(const PageIterator& other) const {
+             return current_ == other.current_;
+         }
+
+         bool operator!=(const PageIterator& other) const {
+             return !(*this == other);
+         }
+
+        private:
+         Iterator NextPageBegin() const {
+             if (static_cast<size_t>(std::distance(current_, range_end_)) > page_size_){
+                 return std::next(current_, page_size_);
+             }
+             return range_end_;
+         }
+
+         Iterator current_;
+         Iterator range_end_;
+         size_t page_size_;
+     };
+
+     Paginator(Iterator range_begin, Iterator range_end, size_t page_size)
+         : range_begin_(range_begin), range_end_(range_end), page_size_(page_size == 0 ? 1 : page_size) {
      }
-          
-    
-    
-    auto begin() const {
-            return sections_.begin();
+
+    PageIterator begin() const {
+            return PageIterator(range_begin_, range_end_, page_size_);
     }
-            
-    auto end() const {
-            return sections_.end();
+
+    PageIterator end() const {
+            return PageIterator(range_end_, range_end_, page_size_);
     }
-            
+
     size_t size() const {
-            return std::distance(sections_.begin(), sections_.end());
+            const size_t total = std::distance(range_begin_, range_end_);
+            return (total + page_size_ - 1) / page_size_;
     }
 
-
+    // Random access to a single page without walking the preceding ones
+    IteratorRange<Iterator> GetPage(size_t page_index) const {
+            const size_t total = std::distance(range_begin_, range_end_);
+            const size_t first = std::min(total, page_index * page_size_);
+            const size_t last = std::min(total, first + page_size_);
+            return IteratorRange<Iterator>(std::next(range_begin_, first), std::next(range_begin_, last));
+    }
 
 private:
 
-     std::vector<IteratorRange<Iterator>> sections_;  
+     Iterator range_begin_;
+     Iterator range_end_;
+     size_t page_size_;
 };
 
 template <typename Iterator>
 std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range){
     for (auto it = range.begin(); it != range.end(); ++it){
-    out << *it;        
+    out << *it;
     }
   return out;
 }
@@ -80,4 +126,4 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
          return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
@@ -0,0 +1,201 @@
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#if defined(__linux__)
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char* const EVENT_NAMES[PERF_EVENT_COUNT] = {"instructions", "cycles", "l1d_misses", "llc_misses", "branch_misses"};
+
+#if defined(__linux__)
+
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr EventConfig EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+// Counts the thread tid, 0 is the calling thread
+int OpenEvent(const EventConfig& event, pid_t tid) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = 1;
+    // User space only, which is all that perf_event_paranoid 2 allows anyway
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+}
+
+std::vector<pid_t> GetThreadIds() {
+    std::vector<pid_t> result;
+    DIR* const dir = opendir("/proc/self/task");
+    if (dir == nullptr) {
+        return result;
+    }
+    while (const dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            result.push_back(static_cast<pid_t>(std::atoi(entry->d_name)));
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+#endif
+
+}  // namespace
+
+bool PerfCounts::IsAvailable() const {
+    for (const bool is_available : available) {
+        if (is_available) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PerfCounters::PerfCounters() {
+#if defined(__linux__)
+    // Every thread gets the counters the calling thread can open
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        const int fd = OpenEvent(EVENT_CONFIGS[i], 0);
+        if (fd < 0 && unavailable_reason_.empty()) {
+            unavailable_reason_ = std::string("perf_event_open: ") + std::strerror(errno);
+        }
+        if (fd >= 0) {
+            is_event_available_[i] = true;
+            close(fd);
+        }
+    }
+    if (IsAvailable()) {
+        unavailable_reason_.clear();
+    }
+#else
+    unavailable_reason_ = "perf_event_open is Linux only";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+    CloseThreadCounters();
+}
+
+bool PerfCounters::IsAvailable() const {
+    for (const bool is_available : is_event_available_) {
+        if (is_available) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::string& PerfCounters::GetUnavailableReason() const {
+    return unavailable_reason_;
+}
+
+void PerfCounters::Start() {
+#if defined(__linux__)
+    CloseThreadCounters();
+    if (!IsAvailable()) {
+        return;
+    }
+    // Opened disabled and enabled together afterwards, so that no thread counts the opening
+    for (const pid_t tid : GetThreadIds()) {
+        auto& fds = thread_fds_.emplace_back();
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            // Fails for threads that ended since the listing
+            fds[i] = is_event_available_[i] ? OpenEvent(EVENT_CONFIGS[i], tid) : -1;
+        }
+    }
+    for (const auto& fds : thread_fds_) {
+        for (const int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+#endif
+}
+
+PerfCounts PerfCounters::Stop() {
+    PerfCounts result;
+#if defined(__linux__)
+    for (const auto& fds : thread_fds_) {
+        for (const int fd : fds) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+    }
+    for (const auto& fds : thread_fds_) {
+        for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+            // value, time enabled, time running; a thread that never ran has nothing to add
+            uint64_t data[3];
+            if (fds[i] < 0 || read(fds[i], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+                continue;
+            }
+            result.available[i] = true;
+            if (data[2] > 0) {
+                result.values[i] += data[2] < data[1] ? static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]) : data[0];
+            }
+        }
+    }
+    CloseThreadCounters();
+#endif
+    return result;
+}
+
+void PerfCounters::CloseThreadCounters() {
+#if defined(__linux__)
+    for (const auto& fds : thread_fds_) {
+        for (const int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+#endif
+    thread_fds_.clear();
+}
+
+void PrintPerfCountsJson(std::ostream& out, const PerfCounts& counts, size_t count) {
+    if (!counts.IsAvailable() || count == 0) {
+        out << "null";
+        return;
+    }
+    out << "{";
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        out << (i == 0 ? "" : ", ") << "\"" << EVENT_NAMES[i] << "\": ";
+        if (counts.available[i]) {
+            out << counts.values[i] * 1.0 / count;
+        } else {
+            out << "null";
+        }
+    }
+    const auto instructions = static_cast<size_t>(PerfEvent::INSTRUCTIONS);
+    const auto cycles = static_cast<size_t>(PerfEvent::CYCLES);
+    out << ", \"ipc\": ";
+    if (counts.available[instructions] && counts.available[cycles] && counts.values[cycles] > 0) {
+        out << counts.values[instructions] * 1.0 / counts.values[cycles];
+    } else {
+        out << "null";
+    }
+    out << "}";
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+enum class PerfEvent {
+    INSTRUCTIONS,
+    CYCLES,
+    L1D_MISSES,      // L1 data cache read misses
+    LLC_MISSES,      // last level cache misses
+    BRANCH_MISSES,
+};
+
+constexpr size_t PERF_EVENT_COUNT = 5;
+
+// Counter values of one measured interval, indexed by PerfEvent
+struct PerfCounts {
+    std::array<uint64_t, PERF_EVENT_COUNT> values{};
+    std::array<bool, PERF_EVENT_COUNT> available{};
+
+    bool IsAvailable() const;
+};
+
+// Hardware counters of all threads of the process, read through Linux perf_event_open. Counters
+// the kernel, the CPU or the permissions do not allow (perf_event_paranoid, containers, virtual
+// machines) are simply left out; elsewhere nothing is available. Values are scaled up when
+// the kernel multiplexed a counter. Start opens the counters of every thread listed in
+// /proc/self/task, so work that parallel algorithms hand to pool threads is counted, but
+// threads started after Start are not: let the pool start its threads before measuring.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool IsAvailable() const;
+
+    // Why no counter could be opened, empty if some could
+    const std::string& GetUnavailableReason() const;
+
+    // Opens and enables the counters of the current threads
+    void Start();
+
+    // Disables the counters and reads what they counted since Start, summed over the threads
+    PerfCounts Stop();
+
+private:
+    std::array<bool, PERF_EVENT_COUNT> is_event_available_{};
+    std::vector<std::array<int, PERF_EVENT_COUNT>> thread_fds_;  // of the running interval
+    std::string unavailable_reason_;
+
+    void CloseThreadCounters();
+};
+
+// {"instructions": ..., "cycles": ..., "l1d_misses": ..., "llc_misses": ..., "branch_misses": ...,
+// "ipc": ...} with every value divided by count and null for unavailable counters; just null
+// if no counter is available
+void PrintPerfCountsJson(std::ostream& out, const PerfCounts& counts, size_t count);
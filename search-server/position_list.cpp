@@ -0,0 +1,73 @@
+#include "position_list.h"
+#include "memory_stats.h"
+#include <algorithm>
+
+void PositionList::Append(uint32_t position) {
+    uint32_t delta = data_.empty() ? position : position - last_position_;
+    while (delta >= 0x80) {
+        data_.push_back(static_cast<char>((delta & 0x7F) | 0x80));
+        delta >>= 7;
+    }
+    data_.push_back(static_cast<char>(delta));
+    last_position_ = position;
+}
+
+template <typename Container>
+void PositionList::DecodeTo(Container& positions) const {
+    uint32_t position = 0;
+    uint32_t delta = 0;
+    int shift = 0;
+    for (const char c : data_) {
+        const auto byte = static_cast<uint8_t>(c);
+        delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte & 0x80) {
+            shift += 7;
+            continue;
+        }
+        position += delta;
+        positions.push_back(position);
+        delta = 0;
+        shift = 0;
+    }
+}
+
+std::vector<uint32_t> PositionList::Decode() const {
+    std::vector<uint32_t> result;
+    DecodeTo(result);
+    return result;
+}
+
+void PositionList::Decode(std::pmr::vector<uint32_t>& positions) const {
+    DecodeTo(positions);
+}
+
+size_t PositionList::GetEncodedSize() const {
+    return data_.size();
+}
+
+size_t PositionList::GetHeapSize() const {
+    return GetStringHeapSize(data_);
+}
+
+bool ContainsPhrase(const std::pmr::vector<std::pmr::vector<uint32_t>>& positions, int slop) {
+    if (positions.empty()) {
+        return true;
+    }
+    for (const uint32_t start : positions[0]) {
+        uint32_t previous = start;
+        bool is_matched = true;
+        for (size_t i = 1; i < positions.size(); ++i) {
+            // Taking the nearest following position never hurts the next words
+            const auto it = std::upper_bound(positions[i].begin(), positions[i].end(), previous);
+            if (it == positions[i].end() || *it > previous + slop + 1) {
+                is_matched = false;
+                break;
+            }
+            previous = *it;
+        }
+        if (is_matched) {
+            return true;
+        }
+    }
+    return false;
+}
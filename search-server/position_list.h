@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Increasing word positions of one term in one document, stored as varint-encoded
+// deltas. Short lists fit into the small-string buffer and need no allocation.
+class PositionList {
+public:
+    // Positions must be appended in increasing order
+    void Append(uint32_t position);
+
+    std::vector<uint32_t> Decode() const;
+
+    // Appends the positions, so that the caller decides where the memory comes from
+    void Decode(std::pmr::vector<uint32_t>& positions) const;
+
+    size_t GetEncodedSize() const;
+
+    // Heap bytes of the encoded data, zero while it fits into the small-string buffer
+    size_t GetHeapSize() const;
+
+private:
+    template <typename Container>
+    void DecodeTo(Container& positions) const;
+
+    std::string data_;
+    uint32_t last_position_ = 0;
+};
+
+// True if the lists contain positions p0 < p1 < ... with p[i] - p[i - 1] <= slop + 1,
+// i.e. the words occur in this order with at most slop other words between neighbours
+bool ContainsPhrase(const std::pmr::vector<std::pmr::vector<uint32_t>>& positions, int slop);
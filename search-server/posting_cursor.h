@@ -0,0 +1,52 @@
+#pragma once
+#include <map>
+
+// Forward-only cursor over a posting list ordered by document id. Seek first tries a few
+// linear steps, which is what nearby targets need, and falls back to a tree lookup
+// for long jumps, so sparse intersections skip whole runs of postings.
+class PostingCursor {
+public:
+    explicit PostingCursor(const std::map<int, double>& postings)
+        : postings_(&postings)
+        , it_(postings.begin()) {
+    }
+
+    bool AtEnd() const {
+        return it_ == postings_->end();
+    }
+
+    int GetDocumentId() const {
+        return it_->first;
+    }
+
+    double GetTermFreq() const {
+        return it_->second;
+    }
+
+    size_t GetSize() const {
+        return postings_->size();
+    }
+
+    void Next() {
+        ++it_;
+    }
+
+    // Moves to the first posting with document id >= target
+    void Seek(int target) {
+        for (int step = 0; step < LINEAR_STEPS; ++step) {
+            if (AtEnd() || it_->first >= target) {
+                return;
+            }
+            ++it_;
+        }
+        if (!AtEnd() && it_->first < target) {
+            it_ = postings_->lower_bound(target);
+        }
+    }
+
+private:
+    static constexpr int LINEAR_STEPS = 4;
+
+    const std::map<int, double>* postings_;
+    std::map<int, double>::const_iterator it_;
+};
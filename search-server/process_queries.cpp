@@ -18,4 +18,8 @@ std::vector<std::vector<Document>> ProcessQueries(const SearchServer& search_ser
         [&search_server](std::string query){ return search_server.SearchServer::FindTopDocuments(query); }
         );
     return result;
-}
\ No newline at end of file
+}
+
+std::vector<std::vector<Document>> ProcessQueriesBatched(const SearchServer& search_server, const std::vector<std::string>& queries){
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
@@ -11,5 +11,11 @@ std::vector<std::vector<Document>> ProcessQueries(
     const std::vector<std::string>& queries);
 
 std::vector<Document> ProcessQueriesJoined(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Same results as ProcessQueries, but the queries share one traversal of the postings
+// of every distinct word, see SearchServer::FindTopDocumentsBatch
+std::vector<std::vector<Document>> ProcessQueriesBatched(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "query_arena.h"
+#include <algorithm>
+
+QueryArena::Scope::Scope()
+    : arena_(ForCurrentThread()) {
+    ++arena_.scope_depth_;
+}
+
+QueryArena::Scope::~Scope() {
+    if (--arena_.scope_depth_ == 0) {
+        arena_.Reset();
+    }
+}
+
+std::pmr::memory_resource* QueryArena::Scope::GetResource() const {
+    return &arena_;
+}
+
+QueryArena& QueryArena::ForCurrentThread() {
+    thread_local QueryArena arena;
+    return arena;
+}
+
+void QueryArena::Reset() {
+    const size_t capacity = GetCapacity();
+    if (blocks_.size() > 1 || capacity > MAX_RETAINED_SIZE) {
+        // The last queries spilled over the first block: one block of the whole size
+        // lets the next such query run without growing the arena again
+        blocks_.clear();
+        AddBlock(capacity > MAX_RETAINED_SIZE ? INITIAL_BLOCK_SIZE : capacity);
+    }
+    current_block_ = 0;
+    offset_ = 0;
+}
+
+size_t QueryArena::GetCapacity() const {
+    size_t result = 0;
+    for (const Block& block : blocks_) {
+        result += block.size;
+    }
+    return result;
+}
+
+void* QueryArena::do_allocate(size_t bytes, size_t alignment) {
+    while (true) {
+        if (current_block_ < blocks_.size()) {
+            Block& block = blocks_[current_block_];
+            void* ptr = block.data.get() + offset_;
+            size_t space = block.size - offset_;
+            if (std::align(alignment, bytes, ptr, space)) {
+                offset_ = block.size - space + bytes;
+                return ptr;
+            }
+            ++current_block_;
+            offset_ = 0;
+            continue;
+        }
+        const size_t next_size = blocks_.empty() ? INITIAL_BLOCK_SIZE : blocks_.back().size * 2;
+        AddBlock(std::max(next_size, bytes + alignment));
+    }
+}
+
+void QueryArena::AddBlock(size_t size) {
+    // Not value-initialised, the arena hands out raw memory
+    blocks_.push_back({std::unique_ptr<std::byte[]>(new std::byte[size]), size});
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator for the scratch memory of queries evaluated on one thread. Deallocation
+// is a no-op, everything is released at once when the outermost Scope ends. The blocks
+// are kept for the next query, so once they have grown to the size the queries need,
+// parsing, accumulation and result building do not touch the global heap at all.
+// Not thread-safe: every thread has its own arena, see ForCurrentThread.
+class QueryArena : public std::pmr::memory_resource {
+public:
+    // A query evaluation on the current thread. Scopes nest (a predicate may run a query
+    // of its own), the arena is rewound when the outermost one ends.
+    class Scope {
+    public:
+        Scope();
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        std::pmr::memory_resource* GetResource() const;
+
+    private:
+        QueryArena& arena_;
+    };
+
+    static constexpr size_t INITIAL_BLOCK_SIZE = 64 * 1024;
+    // A single huge query must not pin its memory for the lifetime of the thread
+    static constexpr size_t MAX_RETAINED_SIZE = 64 * 1024 * 1024;
+
+    QueryArena() = default;
+
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    static QueryArena& ForCurrentThread();
+
+    // Invalidates everything allocated so far
+    void Reset();
+
+    // Bytes reserved in blocks, used or not
+    size_t GetCapacity() const;
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void*, size_t, size_t) override {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void AddBlock(size_t size);
+
+    std::vector<Block> blocks_;
+    size_t current_block_ = 0;
+    size_t offset_ = 0;
+    int scope_depth_ = 0;
+};
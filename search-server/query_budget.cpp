@@ -0,0 +1,48 @@
+#include "query_budget.h"
+#include <algorithm>
+
+SearchBudget SearchBudget::WithTimeout(std::chrono::steady_clock::duration timeout) {
+    SearchBudget budget;
+    budget.deadline = std::chrono::steady_clock::now() + timeout;
+    return budget;
+}
+
+QueryBudget::QueryBudget(const SearchBudget& budget)
+    : deadline_(budget.deadline)
+    , max_postings_(budget.max_postings) {
+}
+
+size_t QueryBudget::Acquire(size_t postings) {
+    if (postings == 0) {
+        return 0;
+    }
+    if (is_exhausted_.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    if (deadline_ != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline_) {
+        is_exhausted_.store(true, std::memory_order_relaxed);
+        return 0;
+    }
+    const size_t before = postings_acquired_.fetch_add(postings, std::memory_order_relaxed);
+    if (before >= max_postings_) {
+        is_exhausted_.store(true, std::memory_order_relaxed);
+        return 0;
+    }
+    if (max_postings_ - before < postings) {
+        is_exhausted_.store(true, std::memory_order_relaxed);
+        return max_postings_ - before;
+    }
+    return postings;
+}
+
+size_t QueryBudget::AcquireChunk(QueryBudget* budget, size_t postings) {
+    return budget == nullptr ? postings : budget->Acquire(std::min(postings, CHECK_INTERVAL));
+}
+
+bool QueryBudget::IsExhausted() const {
+    return is_exhausted_.load(std::memory_order_relaxed);
+}
+
+size_t QueryBudget::GetPostingsVisited() const {
+    return std::min(postings_acquired_.load(std::memory_order_relaxed), max_postings_);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "document.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+// Limits of one bounded query, whichever is reached first ends the evaluation
+struct SearchBudget {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    size_t max_postings = std::numeric_limits<size_t>::max();
+
+    // A deadline that far from now
+    static SearchBudget WithTimeout(std::chrono::steady_clock::duration timeout);
+};
+
+struct BoundedSearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;     // some postings were left unscored
+    size_t postings_visited = 0;
+};
+
+// Work accounting of a bounded query, shared by all threads evaluating it. Scoring loops
+// acquire postings in chunks of up to CHECK_INTERVAL before walking them, so the clock is
+// read once per chunk, not once per posting. Thread-safe.
+class QueryBudget {
+public:
+    static constexpr size_t CHECK_INTERVAL = 256;
+
+    explicit QueryBudget(const SearchBudget& budget);
+
+    // Returns how many of the wanted postings may be scored: all of them, the rest of the
+    // postings budget, or 0 once the deadline has passed. Getting fewer than wanted marks
+    // the query partial and stops every later acquisition.
+    size_t Acquire(size_t postings);
+
+    // Acquire for the scoring loops, whose budget is optional: grants all wanted postings
+    // without a budget and a chunk of at most CHECK_INTERVAL of them with one
+    static size_t AcquireChunk(QueryBudget* budget, size_t postings);
+
+    // True once some postings were refused, the query result is then partial
+    bool IsExhausted() const;
+
+    size_t GetPostingsVisited() const;
+
+private:
+    const std::chrono::steady_clock::time_point deadline_;
+    const size_t max_postings_;
+    std::atomic<size_t> postings_acquired_ = 0;
+    std::atomic<bool> is_exhausted_ = false;
+};
@@ -0,0 +1,116 @@
+#include "query_statistics.h"
+
+namespace {
+
+int GetLatencyBucket(SlidingWindowStats::Clock::duration latency) {
+    uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    int bucket = 0;
+    while (micros > 0 && bucket < LATENCY_BUCKET_COUNT - 1) {
+        micros >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+}  // namespace
+
+double QueryStatsSnapshot::GetEmptyResultRate() const {
+    if (request_count == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(empty_result_count) / request_count;
+}
+
+uint64_t QueryStatsSnapshot::GetLatencyPercentile(double quantile) const {
+    const uint64_t rank = static_cast<uint64_t>(quantile * request_count);
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+        seen += latency_histogram[i];
+        if (seen > rank) {
+            return uint64_t{1} << i;
+        }
+    }
+    return uint64_t{1} << (LATENCY_BUCKET_COUNT - 1);
+}
+
+SlidingWindowStats::SlidingWindowStats(size_t bucket_count, Clock::duration bucket_duration)
+    : buckets_(bucket_count)
+    , bucket_duration_(bucket_duration)
+{
+    for (auto& bucket : buckets_) {
+        bucket.epoch.store(-1, std::memory_order_relaxed);
+        bucket.request_count.store(0, std::memory_order_relaxed);
+        bucket.empty_result_count.store(0, std::memory_order_relaxed);
+        for (auto& counter : bucket.latency_histogram) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+int64_t SlidingWindowStats::GetEpoch(Clock::time_point now) const {
+    return now.time_since_epoch() / bucket_duration_;
+}
+
+void SlidingWindowStats::Record(Clock::time_point now, Clock::duration latency, bool is_result_empty) {
+    const int64_t epoch = GetEpoch(now);
+    Bucket& bucket = buckets_[static_cast<uint64_t>(epoch) % buckets_.size()];
+
+    int64_t seen = bucket.epoch.load(std::memory_order_acquire);
+    while (seen < epoch) {
+        if (bucket.epoch.compare_exchange_weak(seen, epoch, std::memory_order_acq_rel)) {
+            bucket.request_count.store(0, std::memory_order_relaxed);
+            bucket.empty_result_count.store(0, std::memory_order_relaxed);
+            for (auto& counter : bucket.latency_histogram) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+            seen = epoch;
+        }
+    }
+    if (seen > epoch) {
+        // The slot already belongs to a newer period, this sample is too old to count
+        return;
+    }
+
+    bucket.request_count.fetch_add(1, std::memory_order_relaxed);
+    if (is_result_empty) {
+        bucket.empty_result_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    bucket.latency_histogram[GetLatencyBucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+QueryStatsSnapshot SlidingWindowStats::GetSnapshot(Clock::time_point now) const {
+    const int64_t current_epoch = GetEpoch(now);
+    const int64_t oldest_epoch = current_epoch - static_cast<int64_t>(buckets_.size()) + 1;
+    QueryStatsSnapshot result;
+    for (const auto& bucket : buckets_) {
+        const int64_t epoch = bucket.epoch.load(std::memory_order_acquire);
+        if (epoch < oldest_epoch || epoch > current_epoch) {
+            continue;
+        }
+        result.request_count += bucket.request_count.load(std::memory_order_relaxed);
+        result.empty_result_count += bucket.empty_result_count.load(std::memory_order_relaxed);
+        for (int i = 0; i < LATENCY_BUCKET_COUNT; ++i) {
+            result.latency_histogram[i] += bucket.latency_histogram[i].load(std::memory_order_relaxed);
+        }
+    }
+    return result;
+}
+
+QueryStatistics::QueryStatistics()
+    : minute_window_(60, std::chrono::seconds(1))
+    , day_window_(1440, std::chrono::minutes(1))
+{
+}
+
+void QueryStatistics::Record(Clock::time_point now, Clock::duration latency, bool is_result_empty) {
+    minute_window_.Record(now, latency, is_result_empty);
+    day_window_.Record(now, latency, is_result_empty);
+}
+
+QueryStatsSnapshot QueryStatistics::GetLastMinute(Clock::time_point now) const {
+    return minute_window_.GetSnapshot(now);
+}
+
+QueryStatsSnapshot QueryStatistics::GetLastDay(Clock::time_point now) const {
+    return day_window_.GetSnapshot(now);
+}
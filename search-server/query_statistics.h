@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+// Latency bucket i holds requests that took less than 2^i microseconds
+// (bucket 0 is "under 1 us", the last bucket also absorbs everything slower)
+constexpr int LATENCY_BUCKET_COUNT = 32;
+
+struct QueryStatsSnapshot {
+    uint64_t request_count = 0;
+    uint64_t empty_result_count = 0;
+    std::array<uint64_t, LATENCY_BUCKET_COUNT> latency_histogram{};
+
+    double GetEmptyResultRate() const;
+
+    // Upper bound (in microseconds) of the histogram bucket containing the given quantile
+    uint64_t GetLatencyPercentile(double quantile) const;
+};
+
+// Ring of time buckets; a bucket is recycled by the first writer that sees it belongs
+// to an expired epoch. Writes are O(1) and lock-free, reads sum the whole ring.
+// A write that races with the recycling of its bucket may be lost, which is acceptable
+// for monitoring counters.
+class SlidingWindowStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SlidingWindowStats(size_t bucket_count, Clock::duration bucket_duration);
+
+    void Record(Clock::time_point now, Clock::duration latency, bool is_result_empty);
+
+    QueryStatsSnapshot GetSnapshot(Clock::time_point now) const;
+
+private:
+    struct Bucket {
+        std::atomic<int64_t> epoch;
+        std::atomic<uint64_t> request_count;
+        std::atomic<uint64_t> empty_result_count;
+        std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> latency_histogram;
+    };
+
+    int64_t GetEpoch(Clock::time_point now) const;
+
+    std::vector<Bucket> buckets_;
+    const Clock::duration bucket_duration_;
+};
+
+class QueryStatistics {
+public:
+    using Clock = SlidingWindowStats::Clock;
+
+    QueryStatistics();
+
+    void Record(Clock::time_point now, Clock::duration latency, bool is_result_empty);
+
+    QueryStatsSnapshot GetLastMinute(Clock::time_point now = Clock::now()) const;
+
+    QueryStatsSnapshot GetLastDay(Clock::time_point now = Clock::now()) const;
+
+private:
+    SlidingWindowStats minute_window_;
+    SlidingWindowStats day_window_;
+};
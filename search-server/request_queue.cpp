@@ -15,5 +15,13 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string_view raw_qu
         return  AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 int RequestQueue::GetNoResultRequests() const {
-           return requests_with_no_result_;
+           return static_cast<int>(statistics_.GetLastDay().empty_result_count);
+}
+
+QueryStatsSnapshot RequestQueue::GetLastMinuteStats() const {
+           return statistics_.GetLastMinute();
+}
+
+QueryStatsSnapshot RequestQueue::GetLastDayStats() const {
+           return statistics_.GetLastDay();
 }
\ No newline at end of file
@@ -1,28 +1,20 @@
 #pragma once
 #include "search_server.h"
+#include "query_statistics.h"
 #include <vector>
-#include <deque>
 
+// Safe to share between query threads: the server is only read and
+// the statistics are updated with atomic counters
 class RequestQueue {
 public:
     explicit RequestQueue(const SearchServer& search_server);
     
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string_view raw_query, DocumentPredicate document_predicate) {
+        const auto start_time = QueryStatistics::Clock::now();
         auto result = server_.FindTopDocuments(raw_query, document_predicate);
-        bool is_there_result = !result.empty();
-        QueryResult query_result(is_there_result);
-        requests_.push_back(query_result);
-        if (requests_.size() > min_in_day_){
-            requests_.pop_front();
-        }
-        int empty_requests = 0;
-        for (size_t i = 0; i < requests_.size(); ++i){
-            if (requests_[i].is_result_empty == false){
-                ++empty_requests;
-            }
-        }
-        requests_with_no_result_ = empty_requests;
+        const auto end_time = QueryStatistics::Clock::now();
+        statistics_.Record(end_time, end_time - start_time, result.empty());
         return result;
     }
 
@@ -30,22 +22,15 @@ public:
 
     std::vector<Document> AddFindRequest(const std::string_view raw_query);
      
+    // Number of requests with an empty result during the last day
     int GetNoResultRequests() const;
 
+    QueryStatsSnapshot GetLastMinuteStats() const;
+
+    QueryStatsSnapshot GetLastDayStats() const;
+
 private:
-    struct QueryResult {
-        QueryResult() = default;
-        
-        QueryResult(const bool& value){
-            is_result_empty = value;
-        }
-        
-        bool is_result_empty = 0;
-    };
-    
-    std::deque<QueryResult> requests_;
-    const static int min_in_day_ = 1440;
-    int requests_with_no_result_;
+    QueryStatistics statistics_;
     const SearchServer& server_;
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <cmath>
+#include <cstddef>
+
+struct CorpusStatistics {
+    size_t document_count = 0;
+    double average_document_length = 0;
+};
+
+// A scorer is built once per query term from the corpus and term statistics and then
+// called for every posting of the term, so it is passed as a template parameter and the
+// per-posting call inlines into the accumulation loop.
+// term_freq is the share of the document taken by the term (as stored in the index),
+// document_length is the number of indexed words of the document.
+
+class TfIdfScorer {
+public:
+    TfIdfScorer(const CorpusStatistics& corpus, size_t document_freq)
+        : inverse_document_freq_(std::log(corpus.document_count * 1.0 / document_freq)) {
+    }
+
+    double operator()(double term_freq, double) const {
+        return term_freq * inverse_document_freq_;
+    }
+
+private:
+    double inverse_document_freq_;
+};
+
+class Bm25Scorer {
+public:
+    static constexpr double K1 = 1.2;
+    static constexpr double B = 0.75;
+
+    Bm25Scorer(const CorpusStatistics& corpus, size_t document_freq)
+        : inverse_document_freq_(std::log(1.0 + (corpus.document_count * 1.0 - document_freq + 0.5) / (document_freq + 0.5)))
+        , length_factor_(corpus.average_document_length > 0 ? B / corpus.average_document_length : 0) {
+    }
+
+    double operator()(double term_freq, double document_length) const {
+        const double count = term_freq * document_length;
+        return inverse_document_freq_ * count * (K1 + 1) / (count + K1 * (1 - B + length_factor_ * document_length));
+    }
+
+private:
+    double inverse_document_freq_;
+    double length_factor_;
+};
@@ -0,0 +1,34 @@
+#include "search_facets.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+void SearchFacets::Add(DocumentStatus status, int rating, int rating_bucket_width) {
+    ++total_hits;
+    ++status_counts[static_cast<size_t>(status)];
+    ++rating_histogram[GetRatingBucket(rating, rating_bucket_width)];
+}
+
+void SearchFacets::Merge(const SearchFacets& other) {
+    total_hits += other.total_hits;
+    for (size_t i = 0; i < status_counts.size(); ++i) {
+        status_counts[i] += other.status_counts[i];
+    }
+    for (const auto [bucket, count] : other.rating_histogram) {
+        rating_histogram[bucket] += count;
+    }
+}
+
+size_t SearchFacets::GetStatusCount(DocumentStatus status) const {
+    return status_counts[static_cast<size_t>(status)];
+}
+
+int GetRatingBucket(int rating, int rating_bucket_width) {
+    // 64-bit, the lowest bucket may start below INT_MIN and is clamped to it
+    const int64_t width = rating_bucket_width;
+    int64_t bucket = rating / width;
+    if (rating % width < 0) {
+        --bucket;
+    }
+    return static_cast<int>(std::max<int64_t>(bucket * width, std::numeric_limits<int>::min()));
+}
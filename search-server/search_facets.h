@@ -0,0 +1,28 @@
+#pragma once
+#include "document.h"
+#include <array>
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// Match counts of a query by facet. They cover every document the query matches,
+// whatever predicate selects the documents of the top list.
+struct SearchFacets {
+    size_t total_hits = 0;
+    std::array<size_t, 4> status_counts{};  // indexed by DocumentStatus
+    std::map<int, size_t> rating_histogram;  // first rating of a bucket -> matches
+
+    void Add(DocumentStatus status, int rating, int rating_bucket_width);
+
+    void Merge(const SearchFacets& other);
+
+    size_t GetStatusCount(DocumentStatus status) const;
+};
+
+struct FacetedSearchResult {
+    std::vector<Document> documents;
+    SearchFacets facets;
+};
+
+// Buckets are [k * width, (k + 1) * width), negative ratings included
+int GetRatingBucket(int rating, int rating_bucket_width);
@@ -1,17 +1,66 @@
 #include "search_server.h"
+#include <chrono>
 #include <cmath>
 #include <numeric>
 
 
 
-SearchServer::SearchServer(std::string_view stop_words_text)
+namespace {
+
+// Median wall time of a few runs, after one run to warm up caches and worker threads
+template <typename Function>
+double MeasureMedianSeconds(Function function) {
+    constexpr int RUN_COUNT = 3;
+    function();
+    std::vector<double> seconds;
+    for (int i = 0; i < RUN_COUNT; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::nth_element(seconds.begin(), seconds.begin() + RUN_COUNT / 2, seconds.end());
+    return seconds[RUN_COUNT / 2];
+}
+
+struct PolicyProbe {
+    size_t work;
+    double sequential_seconds;
+    double parallel_seconds;
+};
+
+// The least work from which on the parallel evaluation won every probe, by a margin so
+// that timing noise on a busy machine does not flip the decision
+size_t FindParallelCrossover(std::vector<PolicyProbe> probes) {
+    constexpr double MIN_SPEEDUP = 1.1;
+    std::sort(probes.begin(), probes.end(), [](const PolicyProbe& lhs, const PolicyProbe& rhs) {
+        return lhs.work < rhs.work;
+    });
+    size_t result = NEVER_PARALLEL;
+    for (auto it = probes.rbegin(); it != probes.rend() && it->parallel_seconds * MIN_SPEEDUP < it->sequential_seconds; ++it) {
+        result = it->work;
+    }
+    return result;
+}
+
+std::string JoinWords(const std::vector<std::pair<size_t, std::string_view>>& words, size_t count) {
+    std::string result;
+    for (size_t i = 0; i < count; ++i) {
+        result += (i == 0 ? "" : " ");
+        result += words[i].second;
+    }
+    return result;
+}
+
+}  // namespace
+
+SearchServer::SearchServer(std::string_view stop_words_text, const SearchServerOptions& options)
         : SearchServer::SearchServer(
-            SplitIntoWords(stop_words_text))  // Invoke delegating constructor from string container
+            SplitIntoWords(stop_words_text), options)  // Invoke delegating constructor from string container
 {
 }
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-        : SearchServer::SearchServer(std::string_view(stop_words_text))
+SearchServer::SearchServer(const std::string& stop_words_text, const SearchServerOptions& options)
+        : SearchServer::SearchServer(std::string_view(stop_words_text), options)
 {
 }
 
@@ -20,16 +69,462 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
         if ((document_id < 0) || (documents_.count(document_id) > 0)) {
             throw std::invalid_argument("Invalid document_id");
         }
-        const auto it = document_text_.insert(document_text_.end(), static_cast<std::string>(document));
-        const auto words = SplitIntoWordsNoStop(*it);
+        const std::string_view text = options_.lean_index ? document : std::string_view(StoreDocumentText(document));
+        const auto words = SplitIntoWordsNoStop(text);
+        const int rating = ComputeAverageRating(ratings);
+        if (options_.write_ahead_log) {
+            LogDocument(WalRecordType::ADD_DOCUMENT, document_id, text, words, status, rating);
+        }
+        IndexDocument(document_id, words, status, rating);
+}
+
+void SearchServer::UpdateDocument(int document_id, const std::string_view document, DocumentStatus status,
+                     const std::vector<int>& ratings) {
+        if (documents_.count(document_id) == 0) {
+            throw std::out_of_range("Invalid document_id");
+        }
+        const auto words = SplitIntoWordsNoStop(document);
+        const int rating = ComputeAverageRating(ratings);
+        if (options_.write_ahead_log) {
+            LogDocument(WalRecordType::UPDATE_DOCUMENT, document_id, document, words, status, rating);
+        }
+        ReindexDocument(document_id, words, status, rating);
+}
 
+void SearchServer::UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings) {
+        if (documents_.count(document_id) == 0) {
+            throw std::out_of_range("Invalid document_id");
+        }
+        const int rating = ComputeAverageRating(ratings);
+        if (options_.write_ahead_log) {
+            WalRecord record;
+            record.type = WalRecordType::SET_ATTRIBUTES;
+            record.document_id = document_id;
+            record.status = status;
+            record.rating = rating;
+            options_.write_ahead_log->Append(record);
+        }
+        SetDocumentAttributes(document_id, status, rating);
+}
+
+SearchServer::WordPostings SearchServer::FindOrAddWord(std::string_view word, uint32_t& term_id) {
+        if (options_.lean_index) {
+            if (const auto it = term_ids_.find(word); it != term_ids_.end()) {
+                term_id = it->second;
+                if (cold_postings_) {
+                    cold_postings_->Promote(word);
+                }
+                return term_postings_[term_id];
+            }
+            const std::string& stored = term_storage_.emplace_back(word);
+            term_storage_bytes_ += GetStringHeapSize(stored);
+            word = stored;
+            term_id = static_cast<uint32_t>(term_postings_.size());
+            term_ids_.emplace(word, term_id);
+        } else if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end()) {
+            if (cold_postings_) {
+                cold_postings_->Promote(word);
+            }
+            return it;
+        }
+        const auto word_it = word_to_document_freqs_.emplace(word, std::map<int, double>{}).first;
+        term_dictionary_.Insert(word_it->first);
+        if (options_.lean_index) {
+            term_postings_.push_back(word_it);
+        }
+        return word_it;
+}
+
+std::map<int, double>& SearchServer::GetResidentPostings(std::string_view word) {
+        if (cold_postings_) {
+            cold_postings_->Promote(word);
+        }
+        return word_to_document_freqs_.at(word);
+}
+
+size_t SearchServer::GetDocumentFrequency(std::string_view word) const {
+        // A cold map may be filled by another query meanwhile, its size is not read
+        if (cold_postings_ && cold_postings_->Contains(word)) {
+            return cold_postings_->GetPostingCount(word);
+        }
+        return word_to_document_freqs_.at(word).size();
+}
+
+void SearchServer::IndexDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, int rating) {
         const double inv_word_count = 1.0 / words.size();
-        for (const std::string_view word : words) {
-            word_to_document_freqs_[word][document_id] += inv_word_count;
-            document_id_to_word_frequency_[document_id][word] += inv_word_count;
+        std::vector<uint32_t> term_ids;
+        for (size_t position = 0; position < words.size(); ++position) {
+            uint32_t term_id = 0;
+            const auto word_it = FindOrAddWord(words[position], term_id);
+            // The key of the index, it outlives the text with lean_index
+            const std::string_view word = word_it->first;
+            double& term_freq = word_it->second[document_id];
+            if (term_freq == 0) {
+                ++posting_count_;
+                if (options_.lean_index) {
+                    term_ids.push_back(term_id);
+                }
+            }
+            term_freq += inv_word_count;
+            if (!options_.lean_index) {
+                document_id_to_word_frequency_[document_id][word] += inv_word_count;
+            }
+            if (options_.store_positions) {
+                PositionList& positions = word_to_document_positions_[word][document_id];
+                position_bytes_ -= positions.GetHeapSize();
+                positions.Append(position);
+                position_bytes_ += positions.GetHeapSize();
+            }
         }
-        documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
+        std::sort(term_ids.begin(), term_ids.end());
+        term_id_bytes_ += GetVectorHeapSize(term_ids);
+        documents_.emplace(document_id, DocumentData{rating, status, static_cast<double>(words.size()), std::move(term_ids)});
+        total_document_length_ += words.size();
         document_ids_.insert(document_id);
+        if (options_.store_impact_index) {
+            ForEachDocumentWord(document_id, [this, document_id](std::string_view word, double term_freq) {
+                impact_index_.Add(word, document_id, term_freq);
+            });
+        }
+        if (options_.champion_list_size > 0) {
+            AddToChampionLists(document_id);
+        }
+}
+
+void SearchServer::ReindexDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, int rating) {
+        DropCachedWordFrequencies(document_id);
+        DocumentData& document_data = documents_.at(document_id);
+        const int old_rating = document_data.rating;
+
+        // The same sums IndexDocument accumulates, so unchanged terms compare equal
+        const double inv_word_count = 1.0 / words.size();
+        std::vector<std::string_view> sorted_words = words;
+        std::sort(sorted_words.begin(), sorted_words.end());
+        std::vector<std::pair<std::string_view, double>> new_words;
+        for (const std::string_view word : sorted_words) {
+            if (new_words.empty() || new_words.back().first != word) {
+                new_words.emplace_back(word, 0.0);
+            }
+            new_words.back().second += inv_word_count;
+        }
+        std::vector<std::pair<std::string_view, double>> old_words;
+        ForEachDocumentWord(document_id, [&old_words](std::string_view word, double term_freq) {
+            old_words.emplace_back(word, term_freq);
+        });
+        std::sort(old_words.begin(), old_words.end());
+
+        // Terms whose frequency changed, as (key, old frequency, new frequency), zero meaning
+        // absent; words new to the document still view the caller's text
+        std::vector<std::tuple<std::string_view, double, double>> changes;
+        std::vector<std::pair<std::string_view, double>> added_words;
+        auto old_it = old_words.begin();
+        auto new_it = new_words.begin();
+        while (old_it != old_words.end() || new_it != new_words.end()) {
+            if (new_it == new_words.end() || (old_it != old_words.end() && old_it->first < new_it->first)) {
+                changes.emplace_back(old_it->first, old_it->second, 0.0);
+                ++old_it;
+            } else if (old_it == old_words.end() || new_it->first < old_it->first) {
+                added_words.push_back(*new_it);
+                ++new_it;
+            } else {
+                if (old_it->second != new_it->second) {
+                    changes.emplace_back(old_it->first, old_it->second, new_it->second);
+                } else if (rating != old_rating && options_.champion_list_size > 0) {
+                    // Champion lists rank by rating too
+                    changes.emplace_back(old_it->first, old_it->second, old_it->second);
+                }
+                ++old_it;
+                ++new_it;
+            }
+        }
+
+        // Words the index has never seen become keys; without lean_index they have to view
+        // text the server owns, so just they are copied, into one stored string
+        std::string unseen_words;
+        std::vector<bool> is_unseen(added_words.size());
+        if (!options_.lean_index) {
+            for (size_t i = 0; i < added_words.size(); ++i) {
+                is_unseen[i] = word_to_document_freqs_.count(added_words[i].first) == 0;
+                if (is_unseen[i]) {
+                    unseen_words += added_words[i].first;
+                }
+            }
+        }
+        std::string_view stored_text = unseen_words.empty() ? std::string_view() : std::string_view(StoreDocumentText(unseen_words));
+        for (size_t i = 0; i < added_words.size(); ++i) {
+            std::string_view word = added_words[i].first;
+            if (is_unseen[i]) {
+                word = stored_text.substr(0, word.size());
+                stored_text.remove_prefix(word.size());
+            }
+            uint32_t term_id = 0;
+            changes.emplace_back(FindOrAddWord(word, term_id)->first, 0.0, added_words[i].second);
+        }
+
+        auto* word_frequencies = options_.lean_index ? nullptr : &document_id_to_word_frequency_[document_id];
+        for (const auto& [word, old_term_freq, new_term_freq] : changes) {
+            if (old_term_freq == new_term_freq) {
+                continue;
+            }
+            auto& postings = GetResidentPostings(word);
+            if (new_term_freq == 0) {
+                postings.erase(document_id);
+                --posting_count_;
+                if (word_frequencies) {
+                    word_frequencies->erase(word);
+                }
+            } else {
+                if (old_term_freq == 0) {
+                    ++posting_count_;
+                }
+                postings[document_id] = new_term_freq;
+                if (word_frequencies) {
+                    (*word_frequencies)[word] = new_term_freq;
+                }
+            }
+            if (options_.store_impact_index) {
+                if (old_term_freq > 0) {
+                    impact_index_.Remove(word, document_id, old_term_freq);
+                }
+                if (new_term_freq > 0) {
+                    impact_index_.Add(word, document_id, new_term_freq);
+                }
+            }
+        }
+
+        if (options_.store_positions) {
+            // Any edit may shift the positions of every word after it
+            for (const auto& [word, _] : old_words) {
+                auto& positions = word_to_document_positions_.at(word);
+                position_bytes_ -= positions.at(document_id).GetHeapSize();
+                positions.erase(document_id);
+            }
+            for (size_t position = 0; position < words.size(); ++position) {
+                PositionList& positions = word_to_document_positions_[word_to_document_freqs_.find(words[position])->first][document_id];
+                position_bytes_ -= positions.GetHeapSize();
+                positions.Append(position);
+                position_bytes_ += positions.GetHeapSize();
+            }
+        }
+
+        if (options_.lean_index) {
+            std::vector<uint32_t> term_ids;
+            term_ids.reserve(new_words.size());
+            for (const auto& [word, _] : new_words) {
+                term_ids.push_back(term_ids_.at(word));
+            }
+            std::sort(term_ids.begin(), term_ids.end());
+            term_id_bytes_ -= GetVectorHeapSize(document_data.term_ids);
+            term_id_bytes_ += GetVectorHeapSize(term_ids);
+            document_data.term_ids = std::move(term_ids);
+        }
+        total_document_length_ -= static_cast<size_t>(document_data.length);
+        total_document_length_ += words.size();
+        document_data.length = static_cast<double>(words.size());
+        document_data.status = status;
+        document_data.rating = rating;
+
+        if (options_.champion_list_size > 0) {
+            for (const auto& [word, old_term_freq, new_term_freq] : changes) {
+                UpdateChampionEntry(word, document_id, old_term_freq, old_rating, new_term_freq);
+            }
+        }
+}
+
+void SearchServer::SetDocumentAttributes(int document_id, DocumentStatus status, int rating) {
+        DocumentData& document_data = documents_.at(document_id);
+        const int old_rating = document_data.rating;
+        document_data.status = status;
+        document_data.rating = rating;
+        if (options_.champion_list_size > 0 && rating != old_rating) {
+            ForEachDocumentWord(document_id, [this, document_id, old_rating](std::string_view word, double term_freq) {
+                UpdateChampionEntry(word, document_id, term_freq, old_rating, term_freq);
+            });
+        }
+}
+
+void SearchServer::UpdateChampionEntry(std::string_view word, int document_id, double old_term_freq, int old_rating, double new_term_freq) {
+        const auto& postings = GetResidentPostings(word);
+        if (old_term_freq > 0 && champion_index_.Remove(word, {old_term_freq, old_rating, document_id})) {
+            // The rebuilt list already sees the document as it is now
+            BuildChampionList(word, postings);
+            return;
+        }
+        if (new_term_freq == 0) {
+            return;
+        }
+        if (champion_index_.GetList(word) != nullptr) {
+            champion_index_.Add(word, {new_term_freq, documents_.at(document_id).rating, document_id});
+        } else if (postings.size() >= options_.champion_min_postings) {
+            BuildChampionList(word, postings);
+        }
+}
+
+void SearchServer::AddToChampionLists(int document_id) {
+        ForEachDocumentWord(document_id, [this, document_id](std::string_view word, double term_freq) {
+            UpdateChampionEntry(word, document_id, 0, 0, term_freq);
+        });
+}
+
+void SearchServer::BuildChampionList(std::string_view word, const std::map<int, double>& postings) {
+        std::vector<ChampionIndex::Entry> entries;
+        entries.reserve(postings.size());
+        for (const auto [document_id, term_freq] : postings) {
+            entries.push_back({term_freq, documents_.at(document_id).rating, document_id});
+        }
+        champion_index_.Build(word, std::move(entries));
+}
+
+void SearchServer::IndexLoggedDocument(const WalRecord& record, std::unordered_map<std::string_view, WordPostings>& postings_cache) {
+        const std::string_view text = options_.lean_index ? record.text : std::string_view(StoreDocumentText(record.text));
+        const double inv_word_count = 1.0 / record.word_count;
+        std::map<std::string_view, double>* word_frequencies = options_.lean_index ? nullptr : &document_id_to_word_frequency_[record.document_id];
+        std::vector<uint32_t> term_ids;
+        term_ids.reserve(options_.lean_index ? record.terms.size() : 0);
+        for (const WalTerm& term : record.terms) {
+            const std::string_view word = text.substr(term.offset, term.length);
+            // The same sum AddDocument accumulates, so relevances match exactly
+            double term_freq = 0;
+            for (uint32_t i = 0; i < term.count; ++i) {
+                term_freq += inv_word_count;
+            }
+            uint32_t term_id = 0;
+            WordPostings word_it;
+            if (options_.lean_index) {
+                // The term ids are a hash lookup already
+                word_it = FindOrAddWord(word, term_id);
+                term_ids.push_back(term_id);
+            } else {
+                auto cache_it = postings_cache.find(word);
+                if (cache_it == postings_cache.end()) {
+                    cache_it = postings_cache.emplace(word, FindOrAddWord(word, term_id)).first;
+                }
+                word_it = cache_it->second;
+                word_frequencies->emplace_hint(word_frequencies->end(), word_it->first, term_freq);
+            }
+            // Logs mostly grow in id order and the terms are sorted, so the end is a good hint
+            word_it->second.emplace_hint(word_it->second.end(), record.document_id, term_freq);
+        }
+        posting_count_ += record.terms.size();
+        std::sort(term_ids.begin(), term_ids.end());
+        term_id_bytes_ += GetVectorHeapSize(term_ids);
+        documents_.emplace(record.document_id, DocumentData{record.rating, record.status, static_cast<double>(record.word_count), std::move(term_ids)});
+        total_document_length_ += record.word_count;
+        document_ids_.insert(record.document_id);
+        if (options_.store_impact_index) {
+            ForEachDocumentWord(record.document_id, [this, &record](std::string_view word, double term_freq) {
+                impact_index_.Add(word, record.document_id, term_freq);
+            });
+        }
+        if (options_.champion_list_size > 0) {
+            AddToChampionLists(record.document_id);
+        }
+}
+
+void SearchServer::LogDocument(WalRecordType type, int document_id, std::string_view text, const std::vector<std::string_view>& words, DocumentStatus status, int rating) {
+        WalRecord record;
+        record.type = type;
+        record.document_id = document_id;
+        record.status = status;
+        record.rating = rating;
+        record.tokenizer_fingerprint = tokenizer_fingerprint_;
+        record.word_count = static_cast<uint32_t>(words.size());
+        record.text = text;
+        std::vector<std::string_view> sorted_words = words;
+        std::sort(sorted_words.begin(), sorted_words.end());
+        for (size_t begin = 0; begin < sorted_words.size();) {
+            size_t end = begin + 1;
+            while (end < sorted_words.size() && sorted_words[end] == sorted_words[begin]) {
+                ++end;
+            }
+            const std::string_view word = sorted_words[begin];
+            record.terms.push_back({static_cast<uint32_t>(word.data() - text.data()), static_cast<uint32_t>(word.size()),
+                                    static_cast<uint32_t>(end - begin)});
+            begin = end;
+        }
+        options_.write_ahead_log->Append(record);
+}
+
+size_t SearchServer::ReplayWriteAheadLog() {
+        if (!options_.write_ahead_log) {
+            throw std::logic_error("Replay requires write_ahead_log");
+        }
+        const std::string records = options_.write_ahead_log->TakeRecoveredRecords();
+        // Words of the index are never erased, so the cached postings stay valid
+        std::unordered_map<std::string_view, WordPostings> postings_cache;
+        size_t count = 0;
+        WriteAheadLog::ForEachRecord(records, [&](const WalRecord& record) {
+            if (record.type == WalRecordType::REMOVE_DOCUMENT) {
+                RemoveFromIndex(std::execution::seq, record.document_id);
+            } else if (record.type != WalRecordType::ADD_DOCUMENT) {
+                if (documents_.count(record.document_id) == 0) {
+                    throw std::invalid_argument("Invalid document_id in write-ahead log");
+                }
+                if (record.type == WalRecordType::SET_ATTRIBUTES) {
+                    SetDocumentAttributes(record.document_id, record.status, record.rating);
+                } else {
+                    // Only new words are copied out of the recovered records
+                    ReindexDocument(record.document_id, SplitIntoWordsNoStop(record.text), record.status, record.rating);
+                }
+            } else {
+                if (record.document_id < 0 || documents_.count(record.document_id) > 0) {
+                    throw std::invalid_argument("Invalid document_id in write-ahead log");
+                }
+                // Word positions are not logged, and other stop words give other terms
+                if (record.tokenizer_fingerprint == tokenizer_fingerprint_ && !options_.store_positions) {
+                    IndexLoggedDocument(record, postings_cache);
+                } else {
+                    const std::string_view text = options_.lean_index ? record.text : std::string_view(StoreDocumentText(record.text));
+                    IndexDocument(record.document_id, SplitIntoWordsNoStop(text), record.status, record.rating);
+                }
+            }
+            ++count;
+        }, false);
+        return count;
+}
+
+size_t SearchServer::OffloadColdPostings() {
+        if (options_.cold_postings_path.empty()) {
+            throw std::logic_error("Tiered storage requires cold_postings_path");
+        }
+        // Frequent terms stay resident: they are in most queries and take longest to read
+        std::vector<std::pair<size_t, std::string_view>> words;
+        for (const auto& [word, _] : word_to_document_freqs_) {
+            if (const size_t document_count = GetDocumentFrequency(word); document_count > 0) {
+                words.emplace_back(document_count, word);
+            }
+        }
+        std::sort(words.begin(), words.end(), std::greater<>());
+
+        // Lists of the current file are read back one by one while the new file is written
+        auto store = std::make_unique<ColdPostingStore>(options_.cold_postings_path + ".new", options_.cold_pool_size);
+        std::vector<std::string_view> cold_words;
+        size_t resident_bytes = 0;
+        try {
+            for (const auto& [document_count, word] : words) {
+                auto& postings = GetResidentPostings(word);
+                const size_t bytes = document_count * GetTreeNodeSize<std::map<int, double>>();
+                if (cold_words.empty() && resident_bytes + bytes <= options_.resident_postings_budget) {
+                    resident_bytes += bytes;
+                } else {
+                    store->Add(word, postings);
+                    cold_words.push_back(word);
+                }
+            }
+        } catch (...) {
+            // The new file dies with the store, its lists have to be in memory by then
+            for (const std::string_view word : cold_words) {
+                store->Promote(word);
+            }
+            throw;
+        }
+        cold_postings_ = std::move(store);
+        cold_postings_->Rename(options_.cold_postings_path);
+        return cold_words.size();
+}
+
+ColdPostingStats SearchServer::GetColdPostingStats() const {
+        return cold_postings_ ? cold_postings_->GetStats() : ColdPostingStats{};
 }
     
 int SearchServer::GetDocumentCount() const {
@@ -41,22 +536,61 @@ MatchedWordsAndStatus SearchServer::MatchDocument(const std::execution::sequence
 }
 
 MatchedWordsAndStatus SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
- 
-        const auto query = ParseQuery(raw_query);
-        std::vector<std::string_view> matched_words;    
+        QueryArena::Scope arena_scope;
+        return MatchParsedQuery(ParseQuery(raw_query, true, arena_scope.GetResource()), document_id, arena_scope.GetResource());
+}
+
+std::vector<MatchedWordsAndStatus> SearchServer::MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const {
+        return MatchDocuments(std::execution::seq, raw_query, document_ids);
+}
+
+MatchedWordsAndStatus SearchServer::MatchParsedQuery(const Query& query, int document_id, std::pmr::memory_resource* resource) const {
+        const DocumentStatus status = documents_.at(document_id).status;
+        std::map<std::string_view, double> lean_document_words;
+        const auto& document_words = options_.lean_index ? (lean_document_words = CopyWordFrequencies(document_id)) : GetWordFrequencies(document_id);
+
+        for (const Phrase& phrase : query.phrases) {
+            if (!ContainsPhrase(phrase, document_id, resource)) {
+                return {std::vector<std::string_view>{}, status};
+            }
+        }
+        for (const std::string_view word : query.required_words) {
+            if (document_words.count(word) == 0) {
+                return {std::vector<std::string_view>{}, status};
+            }
+        }
+
+        auto document_it = document_words.begin();
         for (const std::string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)) {
-                return {matched_words, documents_.at(document_id).status};
+            while (document_it != document_words.end() && document_it->first < word) {
+                ++document_it;
             }
-        }    
-        for (const std::string_view word : query.plus_words) {
-            if (word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.at(word).count(document_id)) {
-                matched_words.push_back(word);
+            if (document_it == document_words.end()) {
+                break;
             }
-        }   
-        return {matched_words, documents_.at(document_id).status};
-}
+            if (document_it->first == word) {
+                return {std::vector<std::string_view>{}, status};
+            }
+        }
 
+        std::pmr::vector<std::string_view> candidates(resource);
+        const auto& words = query.prefix_groups.empty() ? query.plus_words : (candidates = GetMatchCandidates(query, resource));
+
+        std::vector<std::string_view> matched_words;
+        document_it = document_words.begin();
+        for (const std::string_view word : words) {
+            while (document_it != document_words.end() && document_it->first < word) {
+                ++document_it;
+            }
+            if (document_it == document_words.end()) {
+                break;
+            }
+            if (document_it->first == word) {
+                matched_words.push_back(document_it->first);
+            }
+        }
+        return {matched_words, status};
+}
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
         return FindTopDocuments(
@@ -65,11 +599,28 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
             });
 }
 
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, DocumentStatus status, const ImpactSearchOptions& options) const {
+        return FindTopDocumentsByImpact(
+            raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            }, options);
+}
+
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
         return FindTopDocuments(std::execution::seq, raw_query, DocumentStatus::ACTUAL);
 }
 
 
+bool SearchServer::IsRankedBefore(const Document& lhs, const Document& rhs) {
+        if (std::abs(lhs.relevance - rhs.relevance) >= DELTA) {
+            return lhs.relevance > rhs.relevance;
+        }
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+}
+
 bool SearchServer::IsStopWord(const std::string_view word) const {
         return stop_words_.count(word) > 0;
 }
@@ -94,6 +645,24 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::stri
         return words;
 }
 
+const std::string& SearchServer::StoreDocumentText(std::string_view text) {
+        const std::string& result = document_text_.emplace_back(text);
+        document_text_bytes_ += GetStringHeapSize(result);
+        return result;
+}
+
+uint64_t SearchServer::ComputeTokenizerFingerprint(const std::set<std::string, std::less<>>& stop_words) {
+        // FNV-1a over the sorted stop words, each followed by a zero byte
+        uint64_t hash = 14695981039346656037ull;
+        for (const std::string& word : stop_words) {
+            for (const char c : word) {
+                hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+            }
+            hash = hash * 1099511628211ull;
+        }
+        return hash;
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
         if (ratings.empty()) {
             return 0;
@@ -110,33 +679,97 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
         }
         std::string_view word = text;
         bool is_minus = false;
+        bool is_required = false;
         if (word[0] == '-') {
             is_minus = true;
             word = word.substr(1);
+        } else if (word[0] == '+') {
+            is_required = true;
+            word = word.substr(1);
         }
-        if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
+        if (word.empty() || word[0] == '-' || word[0] == '+' || !IsValidWord(word)) {
             throw std::invalid_argument("Query word " + static_cast<std::string>(text) + " is invalid");
         }
 
-        return {word, is_minus, IsStopWord(word)};
+        const size_t star = word.find('*');
+        if (star != word.npos && star > 0) {
+            const std::string_view limit = word.substr(star + 1);
+            if (std::all_of(limit.begin(), limit.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                if (limit.size() > 6) {
+                    throw std::invalid_argument("Query word " + static_cast<std::string>(text) + " is invalid");
+                }
+                const size_t max_expansions = limit.empty() ? MAX_PREFIX_EXPANSIONS : std::stoul(static_cast<std::string>(limit));
+                if (max_expansions == 0 || is_required) {
+                    throw std::invalid_argument("Query word " + static_cast<std::string>(text) + " is invalid");
+                }
+                return {word.substr(0, star), is_minus, false, max_expansions};
+            }
+        }
+
+        return {word, is_minus, IsStopWord(word), 0, is_required};
 }
 
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool need_sorting) const {
-        Query result;
-        for (const std::string_view word : SplitIntoWords(text)) {
-            const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                    result.minus_words.push_back(query_word.data);
-                } else {
-                    result.plus_words.push_back(query_word.data);
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool need_sorting, std::pmr::memory_resource* resource, bool pin_cold_lists) const {
+        TRACE_SCOPE("parse");
+        Query result(resource);
+        size_t pos = text.find_first_not_of(' ');
+        while (pos != text.npos) {
+            if (text[pos] == '"') {
+                Phrase phrase = ParsePhrase(text, pos, resource);
+                if (!phrase.words.empty()) {
+                    result.plus_words.insert(result.plus_words.end(), phrase.words.begin(), phrase.words.end());
+                    result.phrases.push_back(std::move(phrase));
+                }
+            } else {
+                const size_t space = text.find(' ', pos);
+                const std::string_view word = text.substr(pos, space == text.npos ? text.npos : space - pos);
+                if (word.size() > 1 && word[0] == '-' && word[1] == '"') {
+                    throw std::invalid_argument("Minus phrases are not supported");
+                }
+                const auto query_word = ParseQueryWord(word);
+                if (query_word.max_expansions > 0) {
+                    auto expansions = ExpandPrefix(query_word.data, query_word.max_expansions, resource);
+                    if (query_word.is_minus) {
+                        result.minus_words.insert(result.minus_words.end(), expansions.begin(), expansions.end());
+                    } else if (!expansions.empty()) {
+                        result.prefix_groups.push_back(std::move(expansions));
+                    }
+                } else if (!query_word.is_stop) {
+                    if (query_word.is_minus) {
+                        result.minus_words.push_back(query_word.data);
+                    } else {
+                        result.plus_words.push_back(query_word.data);
+                        if (query_word.is_required) {
+                            result.required_words.push_back(query_word.data);
+                        }
+                    }
                 }
-            }            
+                pos = space;
+            }
+            pos = text.find_first_not_of(' ', pos);
+        }
+    if (!result.phrases.empty() && !options_.store_positions) {
+        throw std::invalid_argument("Phrase queries require the positional index");
+    }
+    if (cold_postings_ && pin_cold_lists) {
+        // Phrase and required words are plus words as well
+        for (const std::string_view word : result.plus_words) {
+            result.cold_pins.Pin(*cold_postings_, word);
+        }
+        for (const std::string_view word : result.minus_words) {
+            result.cold_pins.Pin(*cold_postings_, word);
+        }
+        for (const auto& prefix_words : result.prefix_groups) {
+            for (const std::string_view word : prefix_words) {
+                result.cold_pins.Pin(*cold_postings_, word);
+            }
         }
+    }
     if (need_sorting){
         MakeSortedVectorWithUniqueElements(result.plus_words, std::execution::seq);
         MakeSortedVectorWithUniqueElements(result.minus_words, std::execution::seq);
+        MakeSortedVectorWithUniqueElements(result.required_words, std::execution::seq);
         return result;
     }
     else {
@@ -144,8 +777,336 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool n
     }
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-        return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(word).size());
+SearchServer::Phrase SearchServer::ParsePhrase(const std::string_view text, size_t& pos, std::pmr::memory_resource* resource) const {
+        const size_t closing_quote = text.find('"', pos + 1);
+        if (closing_quote == text.npos) {
+            throw std::invalid_argument("Phrase " + static_cast<std::string>(text.substr(pos)) + " is not closed");
+        }
+        Phrase phrase{std::pmr::vector<std::string_view>(resource)};
+        for (const std::string_view word : SplitIntoWords(text.substr(pos + 1, closing_quote - pos - 1), resource)) {
+            const auto query_word = ParseQueryWord(word);
+            if (query_word.is_minus || query_word.is_required || query_word.max_expansions > 0) {
+                throw std::invalid_argument("Word " + static_cast<std::string>(word) + " is not allowed inside a phrase");
+            }
+            if (!query_word.is_stop) {
+                phrase.words.push_back(query_word.data);
+            }
+        }
+        pos = closing_quote + 1;
+        if (pos < text.size() && text[pos] == '~') {
+            const size_t digits_begin = ++pos;
+            while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+                ++pos;
+            }
+            if (pos == digits_begin || pos - digits_begin > 6) {
+                throw std::invalid_argument("Invalid phrase proximity in " + static_cast<std::string>(text));
+            }
+            phrase.slop = std::stoi(static_cast<std::string>(text.substr(digits_begin, pos - digits_begin)));
+        }
+        if (pos < text.size() && text[pos] != ' ') {
+            throw std::invalid_argument("Phrase must be followed by a space in " + static_cast<std::string>(text));
+        }
+        return phrase;
+}
+
+bool SearchServer::ContainsPhrase(const Phrase& phrase, int document_id, std::pmr::memory_resource* resource) const {
+        std::pmr::vector<std::pmr::vector<uint32_t>> positions(resource);
+        positions.reserve(phrase.words.size());
+        for (const std::string_view word : phrase.words) {
+            const auto word_it = word_to_document_positions_.find(word);
+            if (word_it == word_to_document_positions_.end()) {
+                return false;
+            }
+            const auto document_it = word_it->second.find(document_id);
+            if (document_it == word_it->second.end()) {
+                return false;
+            }
+            document_it->second.Decode(positions.emplace_back());
+        }
+        return ::ContainsPhrase(positions, phrase.slop);
+}
+
+std::optional<std::pmr::vector<int>> SearchServer::FindPhraseDocuments(const Query& query, QueryBudget* budget) const {
+        if (query.phrases.empty()) {
+            return std::nullopt;
+        }
+        TRACE_SCOPE("phrases");
+        // Candidates come from the rarest phrase word, the rest is checked per document
+        const std::map<int, PositionList>* rarest = nullptr;
+        for (const Phrase& phrase : query.phrases) {
+            for (const std::string_view word : phrase.words) {
+                const auto it = word_to_document_positions_.find(word);
+                if (it == word_to_document_positions_.end()) {
+                    return std::pmr::vector<int>(query.GetResource());
+                }
+                if (rarest == nullptr || it->second.size() < rarest->size()) {
+                    rarest = &it->second;
+                }
+            }
+        }
+        std::pmr::vector<int> result(query.GetResource());
+        auto it = rarest->begin();
+        for (size_t remaining = rarest->size(); remaining > 0;) {
+            const size_t granted = QueryBudget::AcquireChunk(budget, remaining);
+            if (granted == 0) {
+                break;
+            }
+            remaining -= granted;
+            for (size_t i = 0; i < granted; ++i, ++it) {
+                const int document_id = it->first;
+                if (std::all_of(query.phrases.begin(), query.phrases.end(),
+                                [&](const Phrase& phrase) { return ContainsPhrase(phrase, document_id, query.GetResource()); })) {
+                    result.push_back(document_id);
+                }
+            }
+        }
+        return result;
+}
+
+std::pmr::vector<std::string_view> SearchServer::ExpandPrefix(const std::string_view prefix, size_t max_expansions, std::pmr::memory_resource* resource) const {
+        std::pmr::vector<std::string_view> result(resource);
+        term_dictionary_.ForEachWithPrefix(prefix, [&result](std::string_view term) {
+            result.push_back(term);
+        });
+        const auto document_count = [this](std::string_view term) {
+            return GetDocumentFrequency(term);
+        };
+        result.erase(std::remove_if(result.begin(), result.end(),
+                                    [&](std::string_view term) { return document_count(term) == 0; }),
+                     result.end());
+        if (result.size() > max_expansions) {
+            std::nth_element(result.begin(), result.begin() + max_expansions, result.end(),
+                             [&](std::string_view lhs, std::string_view rhs) {
+                                 return std::pair(document_count(lhs), rhs) > std::pair(document_count(rhs), lhs);
+                             });
+            result.resize(max_expansions);
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+}
+
+std::pmr::vector<std::string_view> SearchServer::GetMatchCandidates(const Query& query, std::pmr::memory_resource* resource) {
+        std::pmr::vector<std::string_view> result(query.plus_words, resource);
+        for (const auto& prefix_words : query.prefix_groups) {
+            result.insert(result.end(), prefix_words.begin(), prefix_words.end());
+        }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+}
+
+std::pmr::vector<PostingCursor> SearchServer::MakePostingCursors(const std::pmr::vector<std::string_view>& words) const {
+        std::pmr::vector<PostingCursor> result(words.get_allocator());
+        result.reserve(words.size());
+        for (const std::string_view word : words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end()) {
+                result.emplace_back(it->second);
+            }
+        }
+        return result;
+}
+
+size_t SearchServer::EstimateQueryPostings(const Query& query) const {
+        size_t result = 0;
+        const auto add_word = [&](const std::string_view word) {
+            if (const auto it = word_to_document_freqs_.find(word); it != word_to_document_freqs_.end()) {
+                result += it->second.size();
+            }
+        };
+        std::for_each(query.plus_words.begin(), query.plus_words.end(), add_word);
+        for (const auto& prefix_words : query.prefix_groups) {
+            std::for_each(prefix_words.begin(), prefix_words.end(), add_word);
+        }
+        return result;
+}
+
+size_t SearchServer::CountMatchWords(const Query& query) {
+        size_t result = query.plus_words.size() + query.minus_words.size();
+        for (const auto& prefix_words : query.prefix_groups) {
+            result += prefix_words.size();
+        }
+        return result;
+}
+
+const AdaptivePolicyThresholds& SearchServer::GetAdaptivePolicyThresholds() const {
+        return adaptive_thresholds_;
+}
+
+void SearchServer::SetAdaptivePolicyThresholds(const AdaptivePolicyThresholds& thresholds) {
+        adaptive_thresholds_ = thresholds;
+}
+
+AdaptivePolicyThresholds SearchServer::CalibrateAdaptivePolicy() {
+        // Words that read back as plain query words, the most frequent first
+        std::vector<std::pair<size_t, std::string_view>> words;
+        for (const auto& [word, _] : word_to_document_freqs_) {
+            const size_t document_count = GetDocumentFrequency(word);
+            if (document_count > 0 && word[0] != '-' && word[0] != '+' && word.find_first_of("*\"") == word.npos) {
+                words.emplace_back(document_count, word);
+            }
+        }
+        if (words.empty()) {
+            return adaptive_thresholds_;
+        }
+        std::sort(words.begin(), words.end(), std::greater<>());
+
+        // Single words from the most frequent one down to rare ones, then more and more
+        // of the most frequent words together
+        std::vector<std::string> queries;
+        for (size_t length = words.front().first; length > 0; length /= 4) {
+            const auto it = std::lower_bound(words.begin(), words.end(), length, [](const auto& word, size_t value) {
+                return word.first > value;
+            });
+            queries.emplace_back(it == words.end() ? words.back().second : it->second);
+        }
+        for (size_t count = 2; count <= std::min<size_t>(16, words.size()); count *= 2) {
+            queries.push_back(JoinWords(words, count));
+        }
+        std::vector<PolicyProbe> probes;
+        std::vector<Document> documents;
+        const auto accept_all = [](int, DocumentStatus, int) { return true; };
+        for (const std::string& query : queries) {
+            probes.push_back({EstimateQueryPostings(ParseQuery(query)),
+                MeasureMedianSeconds([&] { FindTopDocumentsPage(std::execution::seq, query, accept_all, 0, MAX_RESULT_DOCUMENT_COUNT, documents); }),
+                MeasureMedianSeconds([&] { FindTopDocumentsPage(std::execution::par, query, accept_all, 0, MAX_RESULT_DOCUMENT_COUNT, documents); })});
+        }
+        adaptive_thresholds_.min_parallel_postings = FindParallelCrossover(probes);
+
+        probes.clear();
+        const int document_id = *document_ids_.begin();
+        for (size_t count = 1; count <= std::min<size_t>(1024, words.size()); count *= 2) {
+            const std::string query = JoinWords(words, count);
+            probes.push_back({count,
+                MeasureMedianSeconds([&] { MatchDocument(std::execution::seq, query, document_id); }),
+                MeasureMedianSeconds([&] { MatchDocument(std::execution::par, query, document_id); })});
+        }
+        adaptive_thresholds_.min_parallel_match_words = FindParallelCrossover(probes);
+        return adaptive_thresholds_;
+}
+
+std::pmr::vector<Document> SearchServer::MergeScoredPostings(const Query& query, const std::vector<std::string_view>& words,
+                                                          const std::vector<std::vector<Document>>& scored_postings, std::pmr::memory_resource* resource) const {
+        struct Cursor {
+            const Document* it;
+            const Document* end;
+            size_t word_index;  // position of the word in the query
+        };
+        std::pmr::vector<Cursor> cursors(resource);
+        cursors.reserve(query.plus_words.size());
+        for (size_t i = 0; i < query.plus_words.size(); ++i) {
+            const auto& scored = scored_postings[std::lower_bound(words.begin(), words.end(), query.plus_words[i]) - words.begin()];
+            if (!scored.empty()) {
+                cursors.push_back({scored.data(), scored.data() + scored.size(), i});
+            }
+        }
+        // Equal documents come off the heap in word order, so the floating-point sum is
+        // the one FindAllDocuments accumulates
+        const auto is_later = [](const Cursor& lhs, const Cursor& rhs) {
+            return std::tie(lhs.it->id, lhs.word_index) > std::tie(rhs.it->id, rhs.word_index);
+        };
+        std::make_heap(cursors.begin(), cursors.end(), is_later);
+        const std::pmr::vector<std::string_view> minus_words(query.minus_words, resource);
+        auto minus_cursors = MakePostingCursors(minus_words);
+        std::pmr::vector<Document> matched_documents(resource);
+        while (!cursors.empty()) {
+            const Document& first = *cursors.front().it;
+            const int document_id = first.id;
+            const int rating = first.rating;
+            double relevance = 0;
+            while (!cursors.empty() && cursors.front().it->id == document_id) {
+                std::pop_heap(cursors.begin(), cursors.end(), is_later);
+                Cursor& cursor = cursors.back();
+                relevance += cursor.it->relevance;
+                if (++cursor.it == cursor.end) {
+                    cursors.pop_back();
+                } else {
+                    std::push_heap(cursors.begin(), cursors.end(), is_later);
+                }
+            }
+            if (!IsExcluded(minus_cursors, document_id)) {
+                matched_documents.push_back({document_id, relevance, rating});
+            }
+        }
+        return matched_documents;
+}
+
+bool SearchServer::IsExcluded(std::pmr::vector<PostingCursor>& minus_cursors, int document_id) {
+        for (PostingCursor& cursor : minus_cursors) {
+            cursor.Seek(document_id);
+            if (!cursor.AtEnd() && cursor.GetDocumentId() == document_id) {
+                return true;
+            }
+        }
+        return false;
+}
+
+bool SearchServer::IsInSortedIds(const std::optional<std::pmr::vector<int>>& ids, int document_id) {
+        return !ids || std::binary_search(ids->begin(), ids->end(), document_id);
+}
+
+size_t SearchServer::GetPositionalIndexSize() const {
+        size_t result = 0;
+        for (const auto& [_, documents] : word_to_document_positions_) {
+            for (const auto& [__, positions] : documents) {
+                result += positions.GetEncodedSize();
+            }
+        }
+        return result;
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+        MemoryStats stats;
+        // libstdc++ keeps deque elements in 512-byte blocks; the block map itself is left out
+        const size_t strings_per_block = std::max<size_t>(1, 512 / sizeof(std::string));
+        // Postings of cold lists that are not loaded take no memory
+        const size_t resident_posting_count = posting_count_ - (cold_postings_ ? cold_postings_->GetOffloadedPostingCount() : 0);
+        stats.word_to_document_freqs = {resident_posting_count,
+            word_to_document_freqs_.size() * GetTreeNodeSize<decltype(word_to_document_freqs_)>()
+            + resident_posting_count * GetTreeNodeSize<std::map<int, double>>()};
+        if (cold_postings_) {
+            stats.cold_posting_directory = cold_postings_->GetMemoryUsage();
+        }
+        if (options_.lean_index) {
+            stats.document_term_ids = {posting_count_, term_id_bytes_};
+            // An unordered_map node is the next link, the value and the cached hash
+            stats.term_storage = {term_storage_.size(),
+                (term_storage_.size() / strings_per_block + 1) * GetMallocChunkSize(512) + term_storage_bytes_
+                + term_ids_.size() * GetMallocChunkSize(sizeof(void*) + sizeof(decltype(term_ids_)::value_type) + sizeof(size_t))
+                + GetMallocChunkSize(term_ids_.bucket_count() * sizeof(void*)) + GetVectorHeapSize(term_postings_)};
+            // Only the maps GetWordFrequencies built so far
+            std::lock_guard guard(lean_word_frequencies_->mutex);
+            stats.document_id_to_word_frequency = {lean_word_frequencies_->posting_count,
+                lean_word_frequencies_->maps.size() * GetTreeNodeSize<decltype(lean_word_frequencies_->maps)>()
+                + lean_word_frequencies_->posting_count * GetTreeNodeSize<std::map<std::string_view, double>>()};
+        } else {
+            stats.document_id_to_word_frequency = {posting_count_,
+                document_id_to_word_frequency_.size() * GetTreeNodeSize<decltype(document_id_to_word_frequency_)>()
+                + posting_count_ * GetTreeNodeSize<std::map<std::string_view, double>>()};
+        }
+        stats.documents = {documents_.size(), documents_.size() * GetTreeNodeSize<decltype(documents_)>()};
+        stats.document_ids = {document_ids_.size(), document_ids_.size() * GetTreeNodeSize<decltype(document_ids_)>()};
+        stats.document_text = {document_text_.size(),
+            (document_text_.size() / strings_per_block + 1) * GetMallocChunkSize(512) + document_text_bytes_};
+        if (options_.store_positions) {
+            stats.word_to_document_positions = {posting_count_,
+                word_to_document_positions_.size() * GetTreeNodeSize<decltype(word_to_document_positions_)>()
+                + posting_count_ * GetTreeNodeSize<std::map<int, PositionList>>() + position_bytes_};
+        }
+        stats.impact_index = impact_index_.GetMemoryUsage();
+        stats.champion_lists = champion_index_.GetMemoryUsage();
+        stats.term_dictionary = term_dictionary_.GetMemoryUsage();
+        ReadHeapStats(stats);
+        return stats;
+}
+
+CorpusStatistics SearchServer::GetCorpusStatistics() const {
+        CorpusStatistics result;
+        result.document_count = documents_.size();
+        if (!documents_.empty()) {
+            result.average_document_length = total_document_length_ * 1.0 / documents_.size();
+        }
+        return result;
 }
 
 std::set<int>::iterator SearchServer::begin(){
@@ -158,8 +1119,29 @@ std::set<int>::iterator SearchServer::end(){
 }
 
 const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
+    static const std::map<std::string_view, double> empty_map;
+    if (options_.lean_index) {
+        if (documents_.count(document_id) == 0) {
+            return empty_map;
+        }
+        {
+            std::lock_guard guard(lean_word_frequencies_->mutex);
+            const auto it = lean_word_frequencies_->maps.find(document_id);
+            if (it != lean_word_frequencies_->maps.end()) {
+                return it->second;
+            }
+        }
+        // Built without the lock, cold lists may have to be read; of two concurrent calls
+        // for one document the first to finish is kept
+        auto word_frequencies = CopyWordFrequencies(document_id);
+        std::lock_guard guard(lean_word_frequencies_->mutex);
+        const auto [it, is_inserted] = lean_word_frequencies_->maps.emplace(document_id, std::move(word_frequencies));
+        if (is_inserted) {
+            lean_word_frequencies_->posting_count += it->second.size();
+        }
+        return it->second;
+    }
     if (!document_id_to_word_frequency_.count(document_id)){
-        static std::map<std::string_view, double> empty_map;
         return empty_map;
     }
     else {
@@ -167,14 +1149,25 @@ const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int d
     }
 }
 
-void SearchServer::RemoveDocument(int document_id){
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    std::vector<const std::string_view*> list_vector;
-    for (const auto& element : SearchServer::GetWordFrequencies(document_id)){
-        list_vector.push_back(&element.first);
+std::map<std::string_view, double> SearchServer::CopyWordFrequencies(int document_id) const {
+    std::map<std::string_view, double> word_frequencies;
+    ForEachDocumentWord(document_id, [&word_frequencies](std::string_view word, double term_freq) {
+        word_frequencies.emplace(word, term_freq);
+    });
+    return word_frequencies;
+}
+
+void SearchServer::DropCachedWordFrequencies(int document_id) {
+    if (!lean_word_frequencies_) {
+        return;
     }
-    std::for_each(std::execution::seq, list_vector.begin(), list_vector.end(), [this, document_id](const std::string_view* word){ 
-    word_to_document_freqs_.at(*word).erase(document_id); } );
-    document_id_to_word_frequency_.erase(document_id);
+    const auto it = lean_word_frequencies_->maps.find(document_id);
+    if (it != lean_word_frequencies_->maps.end()) {
+        lean_word_frequencies_->posting_count -= it->second.size();
+        lean_word_frequencies_->maps.erase(it);
+    }
+}
+
+void SearchServer::RemoveDocument(int document_id){
+    RemoveDocument(std::execution::seq, document_id);
 }
\ No newline at end of file
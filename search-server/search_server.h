@@ -12,8 +12,30 @@
 #include <utility>
 #include <string_view>
 #include <execution>
+#include <optional>
+#include <type_traits>
+#include <limits>
+#include <unordered_map>
+#include <memory_resource>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <exception>
+#include "adaptive_policy.h"
+#include "champion_index.h"
+#include "cold_posting_store.h"
 #include "concurrent_map.h"
-#include "log_duration.h"
+#include "impact_index.h"
+#include "memory_stats.h"
+#include "position_list.h"
+#include "posting_cursor.h"
+#include "query_arena.h"
+#include "query_budget.h"
+#include "scoring.h"
+#include "search_facets.h"
+#include "term_dictionary.h"
+#include "trace.h"
+#include "write_ahead_log.h"
 
 
 
@@ -25,69 +47,270 @@ constexpr int SUB_MAPS_COUNT = 16;
 
 const double DELTA = 1e-6;
 
+// Expansions of "word*"; "word*N" asks for at most N, the most frequent terms win
+constexpr size_t MAX_PREFIX_EXPANSIONS = 64;
+
+struct SearchServerOptions {
+    // Keep word positions so that queries may contain "quoted phrases" and "proximity"~N
+    bool store_positions = false;
+    // Keep postings additionally split into impact-ordered segments for FindTopDocumentsByImpact
+    bool store_impact_index = false;
+    // Every AddDocument/RemoveDocument is appended to this log before it is applied;
+    // ReplayWriteAheadLog restores what the log held when it was opened
+    std::shared_ptr<WriteAheadLog> write_ahead_log;
+    // Keep neither the document texts nor the forward index: terms are copied into a
+    // dictionary owned by the server and every document keeps just the ids of its terms.
+    // Takes much less memory; RemoveDocument becomes slower and GetWordFrequencies builds the
+    // map of a document on its first call
+    bool lean_index = false;
+    // Champion lists of this many documents for every term with at least champion_min_postings
+    // postings. FindTopDocuments with TF-IDF then ranks the documents of those lists first and
+    // walks the full postings only when that cannot guarantee the top; zero disables them
+    size_t champion_list_size = 0;
+    size_t champion_min_postings = 1000;
+    // Tiered storage: OffloadColdPostings keeps the lists of the most frequent terms in memory
+    // up to resident_postings_budget bytes and moves the others to this file, from which
+    // queries load them through an LRU buffer pool of cold_pool_size bytes
+    std::string cold_postings_path;
+    size_t resident_postings_budget = 256 << 20;
+    size_t cold_pool_size = 64 << 20;
+};
+
+// Budgets of the score-at-a-time evaluation
+struct ImpactSearchOptions {
+    // Stop after this many postings even if the top documents may still change
+    size_t max_postings = std::numeric_limits<size_t>::max();
+    // Stop once documents outside the top could gain at most this share of the
+    // k-th score; zero keeps the top set exact
+    double score_slack = 0.0;
+};
+
 class SearchServer {
 public:
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words)
+    explicit SearchServer(const StringContainer& stop_words, const SearchServerOptions& options = {})
         : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+        , options_(options)
+        , tokenizer_fingerprint_(ComputeTokenizerFingerprint(stop_words_))
+        , champion_index_(options.champion_list_size)
+        , lean_word_frequencies_(options.lean_index ? std::make_unique<WordFrequencyCache>() : nullptr)
     {
         if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
             throw std::invalid_argument("Some of stop words are invalid");
         }
     }
 
-    explicit SearchServer(std::string_view stop_words_text);
+    explicit SearchServer(std::string_view stop_words_text, const SearchServerOptions& options = {});
     
-    explicit SearchServer(const std::string& stop_words_text);
+    explicit SearchServer(const std::string& stop_words_text, const SearchServerOptions& options = {});
     
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
-    template <typename DocumentPredicate, typename ExecutionPolicy>
+    // Replaces the text, status and ratings of an indexed document in place: the old and new
+    // term frequencies are diffed and only the postings that changed are written, so the cost
+    // follows the size of the edit (stored word positions are rewritten for the whole document).
+    // Words new to the index are copied, the text itself is not stored again. Throws
+    // std::out_of_range for an unknown document_id
+    void UpdateDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Replaces status and ratings only, the postings are left alone
+    void UpdateDocument(int document_id, DocumentStatus status, const std::vector<int>& ratings);
+
+    // Scorer is TfIdfScorer or Bm25Scorer (see scoring.h), e.g. FindTopDocuments<Bm25Scorer>(std::execution::seq, query);
+    // the overloads without a policy always use TF-IDF, except the one taking a predicate.
+    // The policy may also be adaptive_execution, see adaptive_policy.h
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const;
 
-    template <typename ExecutionPolicy>
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
     std::vector<Document> FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const;
     
-    template <typename DocumentPredicate>
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
+    // Offset/limit paging: only offset + limit best documents are selected, the rest stay unsorted
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t offset, size_t limit) const;
+
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const;
+
+    // Same, but the page replaces the contents of result. Scratch memory of a query comes
+    // from the calling thread's QueryArena, so with a reused result vector a sequential
+    // query does not allocate once the arena has warmed up (tests/query_allocation_test.cpp).
+    // Parallel evaluation is not allocation-free and is not meant to be: TBB allocates its
+    // tasks and the workers accumulate on the global heap
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate, typename ExecutionPolicy>
+    void FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t offset, size_t limit, std::vector<Document>& result) const;
+
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    void FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit, std::vector<Document>& result) const;
+
+    // Search-after paging: returns up to limit documents ranked strictly after last_seen,
+    // which is the last document of the previous page (keyed on relevance, rating, id)
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsAfter(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const Document& last_seen, size_t limit) const;
+
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    std::vector<Document> FindTopDocumentsAfter(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, const Document& last_seen, size_t limit) const;
+
+    // Top MAX_RESULT_DOCUMENT_COUNT documents accepted by the predicate together with the
+    // facets of all matches, counted in the same evaluation instead of one query per status
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate, typename ExecutionPolicy>
+    FacetedSearchResult FindTopDocumentsWithFacets(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, int rating_bucket_width = 1) const;
+
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    FacetedSearchResult FindTopDocumentsWithFacets(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, int rating_bucket_width = 1) const;
+
+    // Bounded evaluation for hard latency limits: every loop over postings (plus words,
+    // prefix merges, phrase checks and the candidates of the conjunctive evaluation) checks
+    // the budget every QueryBudget::CHECK_INTERVAL postings and stops once the deadline has
+    // passed or max_postings postings were visited; the best MAX_RESULT_DOCUMENT_COUNT
+    // documents found so far are returned with is_partial set. The words are evaluated in
+    // the same order as by FindTopDocuments, so complete results are the same documents
+    // with the same relevances.
+    template <typename Scorer = TfIdfScorer, typename DocumentPredicate, typename ExecutionPolicy>
+    BoundedSearchResult FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const SearchBudget& budget) const;
+
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    BoundedSearchResult FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, const SearchBudget& budget) const;
+
+    // Evaluates every query like FindTopDocuments(std::execution::seq, query, status), with
+    // identical results, but walks the postings of each distinct plus word once for the whole
+    // batch: every posting is scored once and handed to all queries with that word. Queries
+    // with required words, phrases or prefixes are evaluated one by one. The policy applies
+    // across words and across queries.
+    template <typename Scorer = TfIdfScorer, typename ExecutionPolicy>
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    // Score-at-a-time TF-IDF evaluation over impact-ordered segments (needs store_impact_index):
+    // the highest-impact postings are visited first and the traversal stops as soon as the
+    // top MAX_RESULT_DOCUMENT_COUNT set cannot change or a budget runs out. Relevances of
+    // the returned documents are exact. Queries with required words, phrases or prefixes
+    // fall back to the exhaustive evaluation.
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate, const ImpactSearchOptions& options = {}) const;
+
+    std::vector<Document> FindTopDocumentsByImpact(const std::string_view raw_query, DocumentStatus status, const ImpactSearchOptions& options = {}) const;
+
+    static bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
     int GetDocumentCount() const;
 
     MatchedWordsAndStatus MatchDocument(const std::string_view raw_query, int document_id) const;
     
     MatchedWordsAndStatus MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const;
     
+    // Also takes adaptive_execution
     template <typename ExecutionPolicy>
     MatchedWordsAndStatus MatchDocument(ExecutionPolicy&& policy, const std::string_view raw_query, int document_id) const;
 
+    // Parses the query once and matches it against every document in document_ids,
+    // results are in the same order as the ids
+    std::vector<MatchedWordsAndStatus> MatchDocuments(const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
+    template <typename ExecutionPolicy>
+    std::vector<MatchedWordsAndStatus> MatchDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const;
+
     std::set<int>::iterator begin();
     std::set<int>::iterator end();
 
+    // The reference stays valid until the document is removed or its text updated, the map
+    // is empty for unknown ids. With lean_index the map is built from the postings on the
+    // first call and kept until then
     const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+
+    // A copy of the same map; with lean_index built from the postings without keeping it
+    std::map<std::string_view, double> CopyWordFrequencies(int document_id) const;
     
     void RemoveDocument(int document_id);
 
     template <typename ExecutionPolicy>
     void RemoveDocument(ExecutionPolicy&& policy, int document_id);
 
+    // Bytes taken by the encoded word positions, zero unless store_positions is set
+    size_t GetPositionalIndexSize() const;
+
+    // Entries and heap bytes of every index structure plus the allocator state. The
+    // structures are accounted from counters kept up to date by the mutations, nothing
+    // is walked, so the call is cheap enough for periodic scraping
+    MemoryStats GetMemoryStats() const;
+
+    const AdaptivePolicyThresholds& GetAdaptivePolicyThresholds() const;
+    void SetAdaptivePolicyThresholds(const AdaptivePolicyThresholds& thresholds);
+
+    // Built-in benchmark for adaptive_execution: times sequential against parallel evaluation
+    // of probe queries made of indexed words, from rare single words to many frequent ones,
+    // and sets the thresholds to the least work from which on parallel evaluation wins.
+    // Run it once the index holds representative data; it evaluates about two hundred queries.
+    AdaptivePolicyThresholds CalibrateAdaptivePolicy();
+
+    // Applies the records recovered by options.write_ahead_log when it was opened, without
+    // logging them again; returns the number of records applied. Documents logged under
+    // the same stop words are indexed from their logged terms, the text is not re-tokenised
+    size_t ReplayWriteAheadLog();
+
+    // Moves the posting lists beyond options.resident_postings_budget to the cold file, the
+    // rarest terms first, and rewrites the file; returns the number of cold lists. Updates
+    // bring the lists they touch back into memory for good, run this again after large ones.
+    // Word positions, impact segments and champion lists stay in memory. Throws
+    // std::logic_error without options.cold_postings_path
+    size_t OffloadColdPostings();
+
+    // Pool metrics, all zero before the first OffloadColdPostings
+    ColdPostingStats GetColdPostingStats() const;
+
 private:
 
     struct DocumentData {
         int rating;
         DocumentStatus status;
+        double length;  // number of indexed words, the length norm of BM25
+        std::vector<uint32_t> term_ids;  // lean_index only: the distinct terms, ascending
     };
 
+    using WordPostings = std::map<std::string_view, std::map<int, double>>::iterator;
+
     const std::set<std::string, std::less<>> stop_words_;
+    const SearchServerOptions options_;
+    const uint64_t tokenizer_fingerprint_;
     std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
+    std::map<std::string_view, std::map<int, PositionList>> word_to_document_positions_;
+    ImpactIndex impact_index_;
+    ChampionIndex champion_index_;
     std::map<int, DocumentData> documents_;
     std::set<int> document_ids_;
     std::map<int, std::map<std::string_view, double>> document_id_to_word_frequency_;
     std::deque<std::string> document_text_;
+    size_t total_document_length_ = 0;
+    size_t posting_count_ = 0;  // entries of word_to_document_freqs_, the same as of the forward index
+    size_t document_text_bytes_ = 0;  // heap blocks of the strings in document_text_
+    size_t position_bytes_ = 0;  // heap blocks of the position lists
+    TermDictionary term_dictionary_;
+    // lean_index only: the owned term strings and the term ids of DocumentData::term_ids
+    std::deque<std::string> term_storage_;
+    std::unordered_map<std::string_view, uint32_t> term_ids_;
+    std::vector<WordPostings> term_postings_;  // by term id
+    size_t term_storage_bytes_ = 0;  // heap blocks of the strings in term_storage_
+    size_t term_id_bytes_ = 0;  // heap blocks of the term id lists
+    AdaptivePolicyThresholds adaptive_thresholds_;
+    std::unique_ptr<ColdPostingStore> cold_postings_;  // set by OffloadColdPostings
+
+    // lean_index only: the maps GetWordFrequencies handed out
+    struct WordFrequencyCache {
+        std::mutex mutex;  // GetWordFrequencies may run concurrently with other const calls
+        std::map<int, std::map<std::string_view, double>> maps;
+        size_t posting_count = 0;
+    };
+    std::unique_ptr<WordFrequencyCache> lean_word_frequencies_;
+
+    // Forgets the map GetWordFrequencies built for a lean index, before the terms change
+    void DropCachedWordFrequencies(int document_id);
  
     bool IsStopWord(const std::string_view word) const;
 
@@ -97,79 +320,596 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    const std::string& StoreDocumentText(std::string_view text);
+
+    static uint64_t ComputeTokenizerFingerprint(const std::set<std::string, std::less<>>& stop_words);
+
+    // Postings of the word, added if it is new. Without lean_index the key views the text
+    // the word came from, with it the word is copied into term_storage_; term_id is only
+    // set with lean_index
+    WordPostings FindOrAddWord(std::string_view word, uint32_t& term_id);
+
+    // Postings of an indexed word for an update, loaded for good if they are cold
+    std::map<int, double>& GetResidentPostings(std::string_view word);
+
+    // Without loading cold lists
+    size_t GetDocumentFrequency(std::string_view word) const;
+
+    // Calls callback(word, term_freq) for every term of an indexed document
+    template <typename Callback>
+    void ForEachDocumentWord(int document_id, Callback callback) const;
+
+    // words are the non-stop words of the document, viewing its text in document_text_;
+    // with lean_index they only have to stay valid during the call
+    void IndexDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, int rating);
+
+    // Fast replay path: the forward index comes straight from the logged terms;
+    // postings_cache maps the words seen so far to their postings and saves tree lookups
+    void IndexLoggedDocument(const WalRecord& record, std::unordered_map<std::string_view, WordPostings>& postings_cache);
+
+    // Applies the new words of an indexed document by diffing them against its terms;
+    // words only have to stay valid during the call
+    void ReindexDocument(int document_id, const std::vector<std::string_view>& words, DocumentStatus status, int rating);
+
+    void SetDocumentAttributes(int document_id, DocumentStatus status, int rating);
+
+    // Moves the champion list entry of the document for word from old_term_freq to new_term_freq,
+    // zero standing for no entry; documents_ must already hold the new rating
+    void UpdateChampionEntry(std::string_view word, int document_id, double old_term_freq, int old_rating, double new_term_freq);
+
+    // Offers the postings of a new document to the champion lists; a word that has just
+    // become frequent gets its list built
+    void AddToChampionLists(int document_id);
+
+    void BuildChampionList(std::string_view word, const std::map<int, double>& postings);
+
+    // Logs an ADD_DOCUMENT or UPDATE_DOCUMENT record, words view text
+    void LogDocument(WalRecordType type, int document_id, std::string_view text, const std::vector<std::string_view>& words, DocumentStatus status, int rating);
+
+    template <typename ExecutionPolicy>
+    void RemoveFromIndex(ExecutionPolicy&& policy, int document_id);
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
         bool is_stop;
+        size_t max_expansions = 0;  // non-zero for prefix words, data is the prefix then
+        bool is_required = false;
     };
 
     QueryWord ParseQueryWord(const std::string_view text) const;
 
+    struct Phrase {
+        std::pmr::vector<std::string_view> words;
+        int slop = 0;
+    };
+
+    // All containers of a query and of its evaluation share one memory resource, usually
+    // the arena of the thread running the query. Parallel parts of an evaluation must not
+    // allocate from it, the arena is not thread-safe.
     struct Query {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource* resource)
+            : plus_words(resource)
+            , minus_words(resource)
+            , required_words(resource)
+            , phrases(resource)
+            , prefix_groups(resource) {
+        }
+
+        std::pmr::memory_resource* GetResource() const {
+            return plus_words.get_allocator().resource();
+        }
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
+        std::pmr::vector<std::string_view> required_words;  // +word, also present in plus_words
+        std::pmr::vector<Phrase> phrases;  // every phrase is required, its words are also plus words
+        std::pmr::vector<std::pmr::vector<std::string_view>> prefix_groups;  // expansions of each plus prefix word
+        ColdPostingStore::PinSet cold_pins;  // cold lists of all the words above
     };
 
-    Query ParseQuery(const std::string_view text, bool need_sorting = true) const;
-    
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
-    
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query& query, DocumentPredicate document_predicate) const;
+    // Pins the cold lists of the query words for the lifetime of the query, unless the
+    // caller pins them itself
+    Query ParseQuery(const std::string_view text, bool need_sorting = true,
+                     std::pmr::memory_resource* resource = std::pmr::get_default_resource(), bool pin_cold_lists = true) const;
+
+    // Parses the quoted phrase starting at text[pos] and moves pos past it and its ~N suffix
+    Phrase ParsePhrase(const std::string_view text, size_t& pos, std::pmr::memory_resource* resource) const;
+
+    // Decoded positions are kept in the given resource
+    bool ContainsPhrase(const Phrase& phrase, int document_id, std::pmr::memory_resource* resource) const;
+
+    // Sorted ids of documents containing all query phrases, nullopt if the query has none.
+    // Every candidate checked counts against the budget, if there is one
+    std::optional<std::pmr::vector<int>> FindPhraseDocuments(const Query& query, QueryBudget* budget = nullptr) const;
+
+    static bool IsInSortedIds(const std::optional<std::pmr::vector<int>>& ids, int document_id);
+
+    // Cursors for the words present in the index, missing words are skipped
+    std::pmr::vector<PostingCursor> MakePostingCursors(const std::pmr::vector<std::string_view>& words) const;
 
+    // Document ids must be queried in increasing order, the cursors only move forward
+    static bool IsExcluded(std::pmr::vector<PostingCursor>& minus_cursors, int document_id);
+
+    // Leapfrog intersection driven by the first (shortest) cursor; every posting of that
+    // cursor visited counts against the budget, if there is one
+    template <typename Callback>
+    static void ForEachIntersection(std::pmr::vector<PostingCursor>& cursors, QueryBudget* budget, Callback callback);
+
+    // Document-at-a-time evaluation for queries with required words: only the
+    // intersection of the required postings is scored, by point lookups. Every scored
+    // candidate counts against the budget, if there is one
+    template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
+    std::pmr::vector<Document> FindConjunctiveDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, QueryBudget* budget = nullptr) const;
+
+    std::pmr::vector<std::string_view> ExpandPrefix(const std::string_view prefix, size_t max_expansions, std::pmr::memory_resource* resource) const;
+
+    // Plus words together with all prefix expansions, sorted and unique
+    static std::pmr::vector<std::string_view> GetMatchCandidates(const Query& query, std::pmr::memory_resource* resource);
+
+    // Walks the postings of all expansions of one prefix in a single k-way merge and calls
+    // callback(document_id, document_data, relevance) once per document with the summed relevance.
+    // Every posting counts against the budget, if there is one; the document at a cut-off is
+    // reported with the postings merged so far
+    template <typename Scorer, typename Callback>
+    void ForEachPrefixGroupDocument(const std::pmr::vector<std::string_view>& words, std::pmr::memory_resource* resource, QueryBudget* budget, Callback callback) const;
+
+    // Linear merge of the sorted query words with the document's forward index,
+    // scratch memory comes from resource
+    MatchedWordsAndStatus MatchParsedQuery(const Query& query, int document_id, std::pmr::memory_resource* resource) const;
+
+    // Word by word lookups in the inverted index, spread over the policy
+    template <typename ExecutionPolicy>
+    MatchedWordsAndStatus MatchParsedQuery(ExecutionPolicy&& policy, const Query& query, int document_id) const;
+
+    // Work estimates of adaptive_execution: postings a FindTopDocuments query walks and
+    // words a MatchDocument query looks up
+    size_t EstimateQueryPostings(const Query& query) const;
+    static size_t CountMatchWords(const Query& query);
+
+    // Tiered TF-IDF evaluation: scores only the documents of the champion lists of frequent
+    // plus words and the full postings of the other ones, exactly. Fails (returns false) if a
+    // document outside the lists could still reach the best top_count; on success the matches
+    // hold every document that can, in id order.
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate) const;
+    bool FindChampionDocuments(const Query& query, DocumentPredicate document_predicate, size_t top_count, std::pmr::vector<Document>& matched_documents) const;
+
+    template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+    void SelectTopDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, size_t offset, size_t limit, std::vector<Document>& result) const;
     
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+    CorpusStatistics GetCorpusStatistics() const;
+
+    template <typename Scorer>
+    Scorer MakeScorer(const std::map<int, double>& postings) const;
+    
+    // The matched documents live in the query's memory resource. With a budget the postings
+    // are walked only as far as it grants them, see the bounded FindTopDocuments
+    template <typename Scorer, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const Query& query, DocumentPredicate document_predicate, QueryBudget* budget = nullptr) const;
+
+    template <typename Scorer, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(std::execution::parallel_policy, const Query& query, DocumentPredicate document_predicate, QueryBudget* budget = nullptr) const;
     
-    template <typename T, typename ExecutionPolicy>
-    void MakeSortedVectorWithUniqueElements(std::vector<T>& object, ExecutionPolicy&& policy) const;
+    template <typename Scorer, typename DocumentPredicate>
+    std::pmr::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
+
+    template <typename Container, typename ExecutionPolicy>
+    void MakeSortedVectorWithUniqueElements(Container& object, ExecutionPolicy&& policy) const;
+
+    // Merges the postings scored for the plus words of a query, listed in the same order as
+    // the sorted words, into the query's matches; relevances are summed in word order
+    std::pmr::vector<Document> MergeScoredPostings(const Query& query, const std::vector<std::string_view>& words,
+                                                   const std::vector<std::vector<Document>>& scored_postings, std::pmr::memory_resource* resource) const;
+
+    // Adds every document to facets and drops the ones the predicate rejects
+    template <typename ExecutionPolicy, typename DocumentPredicate>
+    void CountFacets(ExecutionPolicy&& policy, std::pmr::vector<Document>& documents, DocumentPredicate document_predicate, int rating_bucket_width, SearchFacets& facets) const;
+
+    template <typename ExecutionPolicy>
+    static void SelectRankedRange(ExecutionPolicy&& policy, std::pmr::vector<Document>& documents, size_t offset, size_t limit);
 };
 
-template <typename DocumentPredicate, typename ExecutionPolicy>
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
-        
-        const auto query = ParseQuery(raw_query);
+        return FindTopDocumentsPage<Scorer>(policy, raw_query, document_predicate, 0, MAX_RESULT_DOCUMENT_COUNT);
+    }
 
-        auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t offset, size_t limit) const {
+        std::vector<Document> result;
+        FindTopDocumentsPage<Scorer>(policy, raw_query, document_predicate, offset, limit, result);
+        return result;
+}
 
-        std::sort(policy, matched_documents.begin(), matched_documents.end(),
-             [](const Document& lhs, const Document& rhs) {
-                 if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
-                     return lhs.rating > rhs.rating;
-                 } else {
-                     return lhs.relevance > rhs.relevance;
-                 }
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+void SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t offset, size_t limit, std::vector<Document>& result) const {
+        QueryArena::Scope arena_scope;
+
+        const auto query = ParseQuery(raw_query, true, arena_scope.GetResource());
+
+        if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+            if (EstimateQueryPostings(query) >= adaptive_thresholds_.min_parallel_postings) {
+                SelectTopDocuments<Scorer>(std::execution::par, query, document_predicate, offset, limit, result);
+            } else {
+                SelectTopDocuments<Scorer>(std::execution::seq, query, document_predicate, offset, limit, result);
+            }
+        } else {
+            SelectTopDocuments<Scorer>(policy, query, document_predicate, offset, limit, result);
+        }
+}
+
+template <typename DocumentPredicate>
+bool SearchServer::FindChampionDocuments(const Query& query, DocumentPredicate document_predicate, size_t top_count, std::pmr::vector<Document>& matched_documents) const {
+        if (!query.required_words.empty() || !query.phrases.empty() || !query.prefix_groups.empty() || top_count == 0) {
+            return false;
+        }
+        struct ScoredWord {
+            const std::map<int, double>* postings;
+            TfIdfScorer scorer;
+        };
+        std::pmr::vector<ScoredWord> words(query.GetResource());
+        std::pmr::vector<int> candidates(query.GetResource());
+        // Score a document outside every list can reach at most
+        double outside_bound = 0;
+        bool has_outside_documents = false;
+        bool has_champion_list = false;
+        {
+        TRACE_SCOPE("champion lists");
+        for (const std::string_view word : query.plus_words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end() || it->second.empty()) {
+                continue;
+            }
+            const auto scorer = MakeScorer<TfIdfScorer>(it->second);
+            words.push_back({&it->second, scorer});
+            if (const ChampionIndex::List* list = champion_index_.GetList(word)) {
+                has_champion_list = true;
+                for (const ChampionIndex::Entry& entry : list->entries) {
+                    candidates.push_back(entry.document_id);
+                }
+                if (list->outside_max_term_freq > 0) {
+                    has_outside_documents = true;
+                    outside_bound += scorer(list->outside_max_term_freq, 0);
+                }
+            } else {
+                for (const auto& [document_id, _] : it->second) {
+                    candidates.push_back(document_id);
+                }
+            }
+        }
+        }
+        if (!has_champion_list) {
+            return false;
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+        TRACE_SCOPE("scoring");
+        auto minus_cursors = MakePostingCursors(query.minus_words);
+        std::pmr::vector<double> relevances(query.GetResource());
+        for (const int document_id : candidates) {
+            const auto& document_data = documents_.at(document_id);
+            if (!document_predicate(document_id, document_data.status, document_data.rating) || IsExcluded(minus_cursors, document_id)) {
+                continue;
+            }
+            // Summed in plus word order like FindAllDocuments, so relevances are the same
+            double relevance = 0;
+            for (const auto& [postings, scorer] : words) {
+                const auto it = postings->find(document_id);
+                if (it != postings->end()) {
+                    relevance += scorer(it->second, document_data.length);
+                }
+            }
+            matched_documents.push_back({document_id, relevance, document_data.rating});
+            relevances.push_back(relevance);
+        }
+        if (!has_outside_documents) {
+            return true;
+        }
+        if (relevances.size() < top_count) {
+            return false;
+        }
+        // Outside documents must rank strictly below the last wanted one, ties included
+        std::nth_element(relevances.begin(), relevances.begin() + (top_count - 1), relevances.end(), std::greater<>());
+        return outside_bound < relevances[top_count - 1] - DELTA;
+}
+
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+void SearchServer::SelectTopDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, size_t offset, size_t limit, std::vector<Document>& result) const {
+        if constexpr (std::is_same_v<Scorer, TfIdfScorer>) {
+            std::pmr::vector<Document> matched_documents(query.GetResource());
+            const size_t top_count = offset + std::min(limit, std::numeric_limits<size_t>::max() - offset);
+            if (options_.champion_list_size > 0 && FindChampionDocuments(query, document_predicate, top_count, matched_documents)) {
+                SelectRankedRange(policy, matched_documents, offset, limit);
+                result.assign(matched_documents.begin(), matched_documents.end());
+                return;
+            }
+        }
+
+        auto matched_documents = FindAllDocuments<Scorer>(policy, query, document_predicate);
+
+        SelectRankedRange(policy, matched_documents, offset, limit);
+
+        result.assign(matched_documents.begin(), matched_documents.end());
+}
+
+template <typename Scorer, typename ExecutionPolicy>
+void SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit, std::vector<Document>& result) const {
+        FindTopDocumentsPage<Scorer>(
+            policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            }, offset, limit, result);
+}
+
+template <typename Scorer, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, size_t offset, size_t limit) const {
+        return FindTopDocumentsPage<Scorer>(
+            policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            }, offset, limit);
+}
+
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const Document& last_seen, size_t limit) const {
+        QueryArena::Scope arena_scope;
+
+        const auto query = ParseQuery(raw_query, true, arena_scope.GetResource());
+
+        auto matched_documents = FindAllDocuments<Scorer>(policy, query, document_predicate);
+
+        auto it = std::remove_if(policy, matched_documents.begin(), matched_documents.end(),
+             [&last_seen](const Document& document) {
+                 return !IsRankedBefore(last_seen, document);
              });
-        if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-            matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        matched_documents.erase(it, matched_documents.end());
+
+        SelectRankedRange(policy, matched_documents, 0, limit);
+
+        return {matched_documents.begin(), matched_documents.end()};
+}
+
+template <typename Scorer, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, const Document& last_seen, size_t limit) const {
+        return FindTopDocumentsAfter<Scorer>(
+            policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            }, last_seen, limit);
+}
+
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+BoundedSearchResult SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const SearchBudget& budget) const {
+        QueryArena::Scope arena_scope;
+
+        const auto query = ParseQuery(raw_query, true, arena_scope.GetResource());
+
+        QueryBudget query_budget(budget);
+        BoundedSearchResult result;
+        const auto select_top_documents = [&](auto&& evaluation_policy) {
+            auto matched_documents = FindAllDocuments<Scorer>(evaluation_policy, query, document_predicate, &query_budget);
+            SelectRankedRange(evaluation_policy, matched_documents, 0, MAX_RESULT_DOCUMENT_COUNT);
+            result.documents.assign(matched_documents.begin(), matched_documents.end());
+        };
+        if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+            if (EstimateQueryPostings(query) >= adaptive_thresholds_.min_parallel_postings) {
+                select_top_documents(std::execution::par);
+            } else {
+                select_top_documents(std::execution::seq);
+            }
+        } else {
+            select_top_documents(policy);
         }
+        result.is_partial = query_budget.IsExhausted();
+        result.postings_visited = query_budget.GetPostingsVisited();
+        return result;
+}
 
-        return matched_documents;
-    }
+template <typename Scorer, typename ExecutionPolicy>
+BoundedSearchResult SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, const SearchBudget& budget) const {
+        return FindTopDocuments<Scorer>(
+            policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            }, budget);
+}
 
-template <typename DocumentPredicate>
+template <typename Scorer, typename DocumentPredicate, typename ExecutionPolicy>
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentPredicate document_predicate, int rating_bucket_width) const {
+        if (rating_bucket_width <= 0) {
+            throw std::invalid_argument("Rating bucket width must be positive");
+        }
+        QueryArena::Scope arena_scope;
+
+        const auto query = ParseQuery(raw_query, true, arena_scope.GetResource());
+
+        // The facets count documents the predicate rejects, so it is applied after scoring;
+        // a document's relevance does not depend on it
+        auto matched_documents = FindAllDocuments<Scorer>(policy, query, [](int, DocumentStatus, int) { return true; });
+
+        FacetedSearchResult result;
+        CountFacets(policy, matched_documents, document_predicate, rating_bucket_width, result.facets);
+
+        SelectRankedRange(policy, matched_documents, 0, MAX_RESULT_DOCUMENT_COUNT);
+
+        result.documents.assign(matched_documents.begin(), matched_documents.end());
+        return result;
+}
+
+template <typename Scorer, typename ExecutionPolicy>
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status, int rating_bucket_width) const {
+        return FindTopDocumentsWithFacets<Scorer>(
+            policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+                return document_status == status;
+            }, rating_bucket_width);
+}
+
+template <typename Scorer, typename ExecutionPolicy>
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(ExecutionPolicy&& policy, const std::vector<std::string>& raw_queries, DocumentStatus status) const {
+        QueryArena::Scope arena_scope;
+
+        // Parsed up front: exceptions must not escape the parallel parts. Cold lists are
+        // pinned only while they are walked, pins held by the queries of a whole batch
+        // would keep the pool far beyond its size
+        std::vector<Query> queries;
+        queries.reserve(raw_queries.size());
+        for (const std::string& raw_query : raw_queries) {
+            queries.push_back(ParseQuery(raw_query, true, arena_scope.GetResource(), false));
+        }
+        // Loading a cold list may fail, the first error is rethrown after the parallel part
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        const auto keep_error = [&]() {
+            std::lock_guard guard(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        };
+        const auto is_shared = [](const Query& query) {
+            return query.required_words.empty() && query.phrases.empty() && query.prefix_groups.empty();
+        };
+
+        std::vector<std::string_view> words;
+        for (const Query& query : queries) {
+            if (is_shared(query)) {
+                words.insert(words.end(), query.plus_words.begin(), query.plus_words.end());
+            }
+        }
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+
+        // The accepted postings of every word with their score in Document::relevance
+        std::vector<std::vector<Document>> scored_postings(words.size());
+        {
+        TRACE_SCOPE("posting traversal");
+        std::vector<size_t> word_indices(words.size());
+        std::iota(word_indices.begin(), word_indices.end(), 0);
+        std::for_each(policy, word_indices.begin(), word_indices.end(), [&](size_t index) {
+            const auto it = word_to_document_freqs_.find(words[index]);
+            if (it == word_to_document_freqs_.end()) {
+                return;
+            }
+            ColdPostingStore::PinSet pins;
+            if (cold_postings_) {
+                try {
+                    pins.Pin(*cold_postings_, words[index]);
+                } catch (...) {
+                    keep_error();
+                    return;
+                }
+            }
+            const auto scorer = MakeScorer<Scorer>(it->second);
+            auto& scored = scored_postings[index];
+            for (const auto [document_id, term_freq] : it->second) {
+                const auto& document_data = documents_.at(document_id);
+                if (document_data.status == status) {
+                    scored.emplace_back(document_id, scorer(term_freq, document_data.length), document_data.rating);
+                }
+            }
+        });
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+
+        TRACE_SCOPE("collect");
+        std::vector<std::vector<Document>> result(queries.size());
+        std::vector<size_t> query_indices(queries.size());
+        std::iota(query_indices.begin(), query_indices.end(), 0);
+        std::for_each(policy, query_indices.begin(), query_indices.end(), [&](size_t index) {
+            try {
+                if (!is_shared(queries[index])) {
+                    // Parsed and pinned again, for the time of this query only
+                    result[index] = FindTopDocuments<Scorer>(std::execution::seq, raw_queries[index], status);
+                    return;
+                }
+                // The minus words are looked up in the postings
+                ColdPostingStore::PinSet pins;
+                if (cold_postings_) {
+                    for (const std::string_view word : queries[index].minus_words) {
+                        pins.Pin(*cold_postings_, word);
+                    }
+                }
+                // Runs on worker threads, so its scratch memory cannot come from the batch's arena
+                auto matched_documents = MergeScoredPostings(queries[index], words, scored_postings, std::pmr::new_delete_resource());
+                SelectRankedRange(std::execution::seq, matched_documents, 0, MAX_RESULT_DOCUMENT_COUNT);
+                result[index].assign(matched_documents.begin(), matched_documents.end());
+            } catch (...) {
+                keep_error();
+            }
+        });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return result;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate>
+void SearchServer::CountFacets(ExecutionPolicy&& policy, std::pmr::vector<Document>& documents, DocumentPredicate document_predicate, int rating_bucket_width, SearchFacets& facets) const {
+        TRACE_SCOPE("facets");
+        // Every chunk counts into its own facets, they are merged afterwards
+        const size_t chunk_size = (documents.size() + SUB_MAPS_COUNT - 1) / SUB_MAPS_COUNT;
+        std::vector<SearchFacets> chunk_facets(SUB_MAPS_COUNT);
+        std::vector<size_t> chunks(SUB_MAPS_COUNT);
+        std::iota(chunks.begin(), chunks.end(), 0);
+        std::for_each(policy, chunks.begin(), chunks.end(), [&](size_t chunk) {
+            const size_t end = std::min(documents.size(), (chunk + 1) * chunk_size);
+            for (size_t i = chunk * chunk_size; i < end; ++i) {
+                Document& document = documents[i];
+                const DocumentData& document_data = documents_.at(document.id);
+                chunk_facets[chunk].Add(document_data.status, document_data.rating, rating_bucket_width);
+                if (!document_predicate(document.id, document_data.status, document_data.rating)) {
+                    document.id = -1;  // document ids are never negative
+                }
+            }
+        });
+        for (const SearchFacets& chunk : chunk_facets) {
+            facets.Merge(chunk);
+        }
+        documents.erase(std::remove_if(policy, documents.begin(), documents.end(), [](const Document& document) {
+            return document.id < 0;
+        }), documents.end());
+}
+
+template <typename ExecutionPolicy>
+void SearchServer::SelectRankedRange(ExecutionPolicy&& policy, std::pmr::vector<Document>& documents, size_t offset, size_t limit) {
+        if (offset >= documents.size()) {
+            documents.clear();
+            return;
+        }
+        const size_t last = offset + std::min(limit, documents.size() - offset);
+        {
+            TRACE_SCOPE("sort");
+            std::partial_sort(policy, documents.begin(), documents.begin() + last, documents.end(), IsRankedBefore);
+        }
+        TRACE_SCOPE("pagination");
+        documents.resize(last);
+        documents.erase(documents.begin(), documents.begin() + offset);
+}
+
+template <typename Scorer, typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments<Scorer>(std::execution::seq, raw_query, document_predicate);
 }
     
-template <typename ExecutionPolicy>    
+template <typename Scorer, typename ExecutionPolicy>    
 std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, DocumentStatus status) const {
-        return FindTopDocuments(
+        return FindTopDocuments<Scorer>(
             policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
                 return document_status == status;
             });
 }
-template <typename ExecutionPolicy>
-std::vector<Document> SearchServer::SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
-        return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+template <typename Scorer, typename ExecutionPolicy>
+std::vector<Document> SearchServer::FindTopDocuments(ExecutionPolicy&& policy, const std::string_view raw_query) const {
+        return FindTopDocuments<Scorer>(policy, raw_query, DocumentStatus::ACTUAL);
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query,
-                                      DocumentPredicate document_predicate) const {
+template <typename Scorer, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const Query& query,
+                                      DocumentPredicate document_predicate, QueryBudget* budget) const {
+        if (!query.required_words.empty()) {
+            return FindConjunctiveDocuments<Scorer>(std::execution::par, query, document_predicate, budget);
+        }
         ConcurrentMap<int, double> document_to_relevance_tmp(SUB_MAPS_COUNT); 
+        {
+        TRACE_SCOPE("scoring");
         std::for_each(
             std::execution::par,
             query.plus_words.begin(),
@@ -178,100 +918,214 @@ std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_po
                 if (word_to_document_freqs_.count(word) == 0) {
                     return;
                 }   
-               const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-               for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                    const auto& document_data = documents_.at(document_id);
-                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                        document_to_relevance_tmp[document_id].ref_to_value += term_freq * inverse_document_freq;
+               TRACE_SCOPE("posting traversal");
+               const auto& postings = word_to_document_freqs_.at(word);
+               const auto scorer = MakeScorer<Scorer>(postings);
+               auto it = postings.begin();
+               for (size_t remaining = postings.size(); remaining > 0;) {
+                    const size_t granted = QueryBudget::AcquireChunk(budget, remaining);
+                    if (granted == 0) {
+                        return;
+                    }
+                    remaining -= granted;
+                    for (size_t i = 0; i < granted; ++i, ++it) {
+                        const auto [document_id, term_freq] = *it;
+                        const auto& document_data = documents_.at(document_id);
+                        bool is_accepted;
+                        {
+                            TRACE_SCOPE_DETAILED("predicate");
+                            is_accepted = document_predicate(document_id, document_data.status, document_data.rating);
+                        }
+                        if (is_accepted) {
+                            document_to_relevance_tmp[document_id].ref_to_value += scorer(term_freq, document_data.length);
+                        }
                     }
-                };
+               }
             }
         );
-    
-        
-         std::for_each(
+        std::for_each(
             std::execution::par,
-            query.minus_words.begin(),
-            query.minus_words.end(),
-            [&](const auto& word){
-                if (word_to_document_freqs_.count(word) == 0) {
-                    return;
-                }
-                for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                    document_to_relevance_tmp.Erase(document_id);
-                }
+            query.prefix_groups.begin(),
+            query.prefix_groups.end(),
+            [&](const auto& prefix_words){
+                TRACE_SCOPE("prefix traversal");
+                // Runs on worker threads, so its scratch memory cannot come from the query's arena
+                ForEachPrefixGroupDocument<Scorer>(prefix_words, std::pmr::new_delete_resource(), budget, [&](int document_id, const DocumentData& document_data, double relevance) {
+                    if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                        document_to_relevance_tmp[document_id].ref_to_value += relevance;
+                    }
+                });
             }
-         );
-    
+        );
+        }
     
-        std::map<int, double> document_to_relevance = document_to_relevance_tmp.BuildOrdinaryMap();
-        
-        
-        std::vector<Document> matched_documents;
+        const auto phrase_documents = FindPhraseDocuments(query, budget);
 
-        for (const auto [document_id, relevance] : document_to_relevance) {
+        TRACE_SCOPE("collect");
+        const auto document_to_relevance = document_to_relevance_tmp.BuildSortedVector(std::execution::par);
+
+        std::pmr::vector<Document> matched_documents(query.GetResource());
+        auto minus_cursors = MakePostingCursors(query.minus_words);
+
+        for (const auto& [document_id, relevance] : document_to_relevance) {
+            if (!IsInSortedIds(phrase_documents, document_id) || IsExcluded(minus_cursors, document_id)) {
+                continue;
+            }
             matched_documents.push_back(
                 {document_id, relevance, documents_.at(document_id).rating});
         }
         return matched_documents;
     }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query& query,
-                                      DocumentPredicate document_predicate) const {
-        std::map<int, double> document_to_relevance;
+template <typename Scorer, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const Query& query,
+                                      DocumentPredicate document_predicate, QueryBudget* budget) const {
+        if (!query.required_words.empty()) {
+            return FindConjunctiveDocuments<Scorer>(std::execution::seq, query, document_predicate, budget);
+        }
+        std::pmr::map<int, double> document_to_relevance(query.GetResource());
+        {
+        TRACE_SCOPE("scoring");
         for (const std::string_view word : query.plus_words) {
             if (word_to_document_freqs_.count(word) == 0) {
                 continue;
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.at(word)) {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
+            TRACE_SCOPE("posting traversal");
+            const auto& postings = word_to_document_freqs_.at(word);
+            const auto scorer = MakeScorer<Scorer>(postings);
+            // Without a budget the whole list is granted at once
+            auto it = postings.begin();
+            for (size_t remaining = postings.size(); remaining > 0;) {
+                const size_t granted = QueryBudget::AcquireChunk(budget, remaining);
+                if (granted == 0) {
+                    break;
+                }
+                remaining -= granted;
+                for (size_t i = 0; i < granted; ++i, ++it) {
+                    const auto [document_id, term_freq] = *it;
+                    const auto& document_data = documents_.at(document_id);
+                    bool is_accepted;
+                    {
+                        TRACE_SCOPE_DETAILED("predicate");
+                        is_accepted = document_predicate(document_id, document_data.status, document_data.rating);
+                    }
+                    if (is_accepted) {
+                        document_to_relevance[document_id] += scorer(term_freq, document_data.length);
+                    }
                 }
             }
         }
-
-        for (const std::string_view word : query.minus_words) {
-            if (word_to_document_freqs_.count(word) == 0) {
-                continue;
-            }
-            for (const auto [document_id, _] : word_to_document_freqs_.at(word)) {
-                document_to_relevance.erase(document_id);
-            }
+        for (const auto& prefix_words : query.prefix_groups) {
+            TRACE_SCOPE("prefix traversal");
+            ForEachPrefixGroupDocument<Scorer>(prefix_words, query.GetResource(), budget, [&](int document_id, const DocumentData& document_data, double relevance) {
+                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                    document_to_relevance[document_id] += relevance;
+                }
+            });
+        }
         }
 
-        std::vector<Document> matched_documents;
+        const auto phrase_documents = FindPhraseDocuments(query, budget);
+
+        TRACE_SCOPE("collect");
+        std::pmr::vector<Document> matched_documents(query.GetResource());
+        auto minus_cursors = MakePostingCursors(query.minus_words);
         for (const auto [document_id, relevance] : document_to_relevance) {
+            if (!IsInSortedIds(phrase_documents, document_id) || IsExcluded(minus_cursors, document_id)) {
+                continue;
+            }
             matched_documents.push_back(
                 {document_id, relevance, documents_.at(document_id).rating});
         }
         return matched_documents;
     }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query,
+template <typename Scorer, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindAllDocuments(const Query& query,
                                       DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+    return FindAllDocuments<Scorer>(std::execution::seq, query, document_predicate);
 }
     
 
-template <typename ExecutionPolicy> 
+template <typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id){
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
-    std::vector<const std::string_view*> list_vector;
-    for (const auto& element : SearchServer::GetWordFrequencies(document_id)){
-        list_vector.push_back(&element.first);
+    if (options_.write_ahead_log && documents_.count(document_id) > 0) {
+        WalRecord record;
+        record.type = WalRecordType::REMOVE_DOCUMENT;
+        record.document_id = document_id;
+        options_.write_ahead_log->Append(record);
+    }
+    RemoveFromIndex(policy, document_id);
+}
+
+template <typename Callback>
+void SearchServer::ForEachDocumentWord(int document_id, Callback callback) const {
+    if (!options_.lean_index) {
+        for (const auto& [word, term_freq] : GetWordFrequencies(document_id)) {
+            callback(word, term_freq);
+        }
+        return;
+    }
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return;
+    }
+    for (const uint32_t term_id : it->second.term_ids) {
+        const auto& [word, postings] = *term_postings_[term_id];
+        // The term frequency is in the postings, a cold list is loaded for the lookup
+        ColdPostingStore::PinSet pins;
+        if (cold_postings_) {
+            pins.Pin(*cold_postings_, word);
+        }
+        callback(word, postings.at(document_id));
     }
-    for_each(policy, list_vector.begin(), list_vector.end(), [this, document_id](const std::string_view* word){ 
-        word_to_document_freqs_.at(*word).erase(document_id); } );
-        document_id_to_word_frequency_.erase(document_id);
 }
 
-template <typename T, typename ExecutionPolicy>
-void SearchServer::MakeSortedVectorWithUniqueElements(std::vector<T>& object, ExecutionPolicy&& policy) const {
+template <typename ExecutionPolicy> 
+void SearchServer::RemoveFromIndex(ExecutionPolicy&& policy, int document_id){
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return;
+    }
+    std::vector<std::pair<std::string_view, double>> words;
+    ForEachDocumentWord(document_id, [&words](std::string_view word, double term_freq) {
+        words.emplace_back(word, term_freq);
+    });
+    posting_count_ -= words.size();
+    for (const auto& [word, _] : words) {
+        GetResidentPostings(word);
+    }
+    for_each(policy, words.begin(), words.end(), [this, document_id](const std::pair<std::string_view, double>& word){ 
+        word_to_document_freqs_.at(word.first).erase(document_id); } );
+    if (options_.store_positions) {
+        for (const auto& [word, _] : words) {
+            position_bytes_ -= word_to_document_positions_.at(word).at(document_id).GetHeapSize();
+        }
+        for_each(policy, words.begin(), words.end(), [this, document_id](const std::pair<std::string_view, double>& word){
+            word_to_document_positions_.at(word.first).erase(document_id); } );
+    }
+    if (options_.store_impact_index) {
+        for (const auto& [word, term_freq] : words) {
+            impact_index_.Remove(word, document_id, term_freq);
+        }
+    }
+    if (options_.champion_list_size > 0) {
+        for (const auto& [word, term_freq] : words) {
+            if (champion_index_.Remove(word, {term_freq, document_it->second.rating, document_id})) {
+                BuildChampionList(word, word_to_document_freqs_.at(word));
+            }
+        }
+    }
+    total_document_length_ -= static_cast<size_t>(document_it->second.length);
+    term_id_bytes_ -= GetVectorHeapSize(document_it->second.term_ids);
+    documents_.erase(document_it);
+    document_ids_.erase(document_id);
+    document_id_to_word_frequency_.erase(document_id);
+    DropCachedWordFrequencies(document_id);
+}
+
+template <typename Container, typename ExecutionPolicy>
+void SearchServer::MakeSortedVectorWithUniqueElements(Container& object, ExecutionPolicy&& policy) const {
         std::sort(policy, object.begin(), object.end());
         auto it = std::unique(object.begin(), object.end());
         object.erase(it, object.end());
@@ -280,15 +1134,39 @@ void SearchServer::MakeSortedVectorWithUniqueElements(std::vector<T>& object, Ex
 template <typename ExecutionPolicy> 
 MatchedWordsAndStatus SearchServer::MatchDocument(ExecutionPolicy&& policy, const std::string_view raw_query, int document_id) const {
 
-        const auto query = ParseQuery(raw_query, false);
+        QueryArena::Scope arena_scope;
+
+        if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+            const auto query = ParseQuery(raw_query, true, arena_scope.GetResource());
+            if (CountMatchWords(query) >= adaptive_thresholds_.min_parallel_match_words) {
+                return MatchParsedQuery(std::execution::par, query, document_id);
+            }
+            return MatchParsedQuery(query, document_id, arena_scope.GetResource());
+        } else {
+            const auto query = ParseQuery(raw_query, false, arena_scope.GetResource());
+            return MatchParsedQuery(policy, query, document_id);
+        }
+}
+
+template <typename ExecutionPolicy>
+MatchedWordsAndStatus SearchServer::MatchParsedQuery(ExecutionPolicy&& policy, const Query& query, int document_id) const {
+        std::map<std::string_view, double> lean_document_words;
+        const auto& document_words = options_.lean_index ? (lean_document_words = CopyWordFrequencies(document_id)) : GetWordFrequencies(document_id);
+        if (!std::all_of(query.phrases.begin(), query.phrases.end(), [&](const Phrase& phrase){ return ContainsPhrase(phrase, document_id, query.GetResource()); })
+            || !std::all_of(query.required_words.begin(), query.required_words.end(), [&](const std::string_view word){ return document_words.count(word) > 0; })) {
+            return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+        }
          
         if (std::any_of(policy, query.minus_words.begin(), query.minus_words.end(), [&](const std::string_view word){ return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id); })){
-        return {{}, documents_.at(document_id).status};
+        return {std::vector<std::string_view>{}, documents_.at(document_id).status};
         }
         
-        std::vector<std::string_view> matched_words(query.plus_words.size());
+        std::pmr::vector<std::string_view> expanded_words(query.GetResource());
+        const auto& candidates = query.prefix_groups.empty() ? query.plus_words : (expanded_words = GetMatchCandidates(query, query.GetResource()));
+
+        std::vector<std::string_view> matched_words(candidates.size());
         
-        auto it = std::copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [&](const std::string_view word){ return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id); } );
+        auto it = std::copy_if(policy, candidates.begin(), candidates.end(), matched_words.begin(), [&](const std::string_view word){ return word_to_document_freqs_.count(word) && word_to_document_freqs_.at(word).count(document_id); } );
         
         matched_words.resize(it - matched_words.begin());
         
@@ -297,4 +1175,338 @@ MatchedWordsAndStatus SearchServer::MatchDocument(ExecutionPolicy&& policy, cons
         return {matched_words, documents_.at(document_id).status};
 }
 
+template <typename ExecutionPolicy>
+std::vector<MatchedWordsAndStatus> SearchServer::MatchDocuments(ExecutionPolicy&& policy, const std::string_view raw_query, const std::vector<int>& document_ids) const {
+        // Exceptions must not escape a policy-based algorithm, so ids are validated up front
+        for (const int document_id : document_ids) {
+            if (documents_.count(document_id) == 0) {
+                throw std::out_of_range("Invalid document_id");
+            }
+        }
+        QueryArena::Scope arena_scope;
+        const auto query = ParseQuery(raw_query, true, arena_scope.GetResource());
+        std::vector<MatchedWordsAndStatus> result(document_ids.size());
+        // The documents may be matched on worker threads, which must not use this thread's arena
+        std::transform(policy, document_ids.begin(), document_ids.end(), result.begin(),
+            [this, &query](int document_id) { return MatchParsedQuery(query, document_id, std::pmr::new_delete_resource()); });
+        return result;
+}
+
+template <typename Scorer, typename Callback>
+void SearchServer::ForEachPrefixGroupDocument(const std::pmr::vector<std::string_view>& words, std::pmr::memory_resource* resource, QueryBudget* budget, Callback callback) const {
+        struct Cursor {
+            std::map<int, double>::const_iterator it;
+            std::map<int, double>::const_iterator end;
+            Scorer scorer;
+        };
+        std::pmr::vector<Cursor> cursors(resource);
+        cursors.reserve(words.size());
+        size_t remaining = 0;
+        for (const std::string_view word : words) {
+            const auto& postings = word_to_document_freqs_.at(word);
+            if (!postings.empty()) {
+                cursors.push_back({postings.begin(), postings.end(), MakeScorer<Scorer>(postings)});
+                remaining += postings.size();
+            }
+        }
+        const auto is_later = [](const Cursor& lhs, const Cursor& rhs) { return lhs.it->first > rhs.it->first; };
+        std::make_heap(cursors.begin(), cursors.end(), is_later);
+        size_t granted = 0;
+        while (!cursors.empty()) {
+            const int document_id = cursors.front().it->first;
+            const DocumentData& document_data = documents_.at(document_id);
+            double relevance = 0;
+            bool is_scored = false;
+            while (!cursors.empty() && cursors.front().it->first == document_id) {
+                if (granted == 0) {
+                    granted = QueryBudget::AcquireChunk(budget, remaining);
+                    if (granted == 0) {
+                        if (is_scored) {
+                            callback(document_id, document_data, relevance);
+                        }
+                        return;
+                    }
+                    remaining -= granted;
+                }
+                --granted;
+                is_scored = true;
+                std::pop_heap(cursors.begin(), cursors.end(), is_later);
+                Cursor& cursor = cursors.back();
+                relevance += cursor.scorer(cursor.it->second, document_data.length);
+                if (++cursor.it == cursor.end) {
+                    cursors.pop_back();
+                } else {
+                    std::push_heap(cursors.begin(), cursors.end(), is_later);
+                }
+            }
+            callback(document_id, document_data, relevance);
+        }
+}
+
+template <typename Callback>
+void SearchServer::ForEachIntersection(std::pmr::vector<PostingCursor>& cursors, QueryBudget* budget, Callback callback) {
+        if (cursors.empty()) {
+            return;
+        }
+        size_t granted = 0;
+        while (!cursors[0].AtEnd()) {
+            if (granted == 0) {
+                granted = QueryBudget::AcquireChunk(budget, cursors[0].GetSize());
+                if (granted == 0) {
+                    return;
+                }
+            }
+            --granted;
+            const int candidate = cursors[0].GetDocumentId();
+            bool is_common = true;
+            for (size_t i = 1; i < cursors.size(); ++i) {
+                cursors[i].Seek(candidate);
+                if (cursors[i].AtEnd()) {
+                    return;
+                }
+                if (cursors[i].GetDocumentId() != candidate) {
+                    cursors[0].Seek(cursors[i].GetDocumentId());
+                    is_common = false;
+                    break;
+                }
+            }
+            if (is_common) {
+                callback(candidate);
+                cursors[0].Next();
+            }
+        }
+}
+
+template <typename Scorer, typename ExecutionPolicy, typename DocumentPredicate>
+std::pmr::vector<Document> SearchServer::FindConjunctiveDocuments(ExecutionPolicy&& policy, const Query& query, DocumentPredicate document_predicate, QueryBudget* budget) const {
+        auto required_cursors = MakePostingCursors(query.required_words);
+        if (required_cursors.size() < query.required_words.size()) {
+            return std::pmr::vector<Document>(query.GetResource());
+        }
+        std::sort(required_cursors.begin(), required_cursors.end(), [](const PostingCursor& lhs, const PostingCursor& rhs) {
+            return lhs.GetSize() < rhs.GetSize();
+        });
+        auto minus_cursors = MakePostingCursors(query.minus_words);
+        const auto phrase_documents = FindPhraseDocuments(query, budget);
+
+        std::pmr::vector<int> candidates(query.GetResource());
+        {
+        TRACE_SCOPE("intersection");
+        ForEachIntersection(required_cursors, budget, [&](int document_id) {
+            if (IsExcluded(minus_cursors, document_id) || !IsInSortedIds(phrase_documents, document_id)) {
+                return;
+            }
+            const auto& document_data = documents_.at(document_id);
+            if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                candidates.push_back(document_id);
+            }
+        });
+        }
+
+        TRACE_SCOPE("scoring");
+        std::pmr::vector<std::pair<const std::map<int, double>*, Scorer>> weighted_postings(query.GetResource());
+        const auto add_word = [&](const std::string_view word) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it != word_to_document_freqs_.end() && !it->second.empty()) {
+                weighted_postings.emplace_back(&it->second, MakeScorer<Scorer>(it->second));
+            }
+        };
+        std::for_each(query.plus_words.begin(), query.plus_words.end(), add_word);
+        for (const auto& prefix_words : query.prefix_groups) {
+            std::for_each(prefix_words.begin(), prefix_words.end(), add_word);
+        }
+
+        std::pmr::vector<Document> matched_documents(candidates.size(), query.GetResource());
+        const auto score = [&](int document_id) {
+            const DocumentData& document_data = documents_.at(document_id);
+            double relevance = 0;
+            for (const auto& [postings, scorer] : weighted_postings) {
+                const auto it = postings->find(document_id);
+                if (it != postings->end()) {
+                    relevance += scorer(it->second, document_data.length);
+                }
+            }
+            return Document{document_id, relevance, document_data.rating};
+        };
+        // Without a budget all candidates are scored in one pass
+        size_t scored_count = 0;
+        while (scored_count < candidates.size()) {
+            const size_t granted = QueryBudget::AcquireChunk(budget, candidates.size() - scored_count);
+            if (granted == 0) {
+                break;
+            }
+            std::transform(policy, candidates.begin() + scored_count, candidates.begin() + scored_count + granted,
+                           matched_documents.begin() + scored_count, score);
+            scored_count += granted;
+        }
+        matched_documents.resize(scored_count);
+        return matched_documents;
+}
+
+template <typename Scorer>
+Scorer SearchServer::MakeScorer(const std::map<int, double>& postings) const {
+        return Scorer(GetCorpusStatistics(), postings.size());
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate, const ImpactSearchOptions& options) const {
+        if (!options_.store_impact_index) {
+            throw std::logic_error("Impact-ordered search requires store_impact_index");
+        }
+        QueryArena::Scope arena_scope;
+        std::pmr::memory_resource* resource = arena_scope.GetResource();
+        const auto query = ParseQuery(raw_query, true, resource);
+        if (!query.required_words.empty() || !query.phrases.empty() || !query.prefix_groups.empty()) {
+            auto matched_documents = FindAllDocuments<TfIdfScorer>(query, document_predicate);
+            SelectRankedRange(std::execution::seq, matched_documents, 0, MAX_RESULT_DOCUMENT_COUNT);
+            return {matched_documents.begin(), matched_documents.end()};
+        }
+
+        struct SegmentRef {
+            double max_score;
+            TfIdfScorer scorer;
+            size_t term_index;
+            const ImpactIndex::Segment* postings;
+        };
+        std::pmr::vector<SegmentRef> segments(resource);
+        std::pmr::vector<std::pmr::vector<double>> term_bounds(resource);  // max_score of each term's segments, decreasing
+        {
+        TRACE_SCOPE("segments");
+        for (const std::string_view word : query.plus_words) {
+            const auto word_it = word_to_document_freqs_.find(word);
+            const auto* word_segments = impact_index_.GetSegments(word);
+            if (word_it == word_to_document_freqs_.end() || word_it->second.empty() || word_segments == nullptr) {
+                continue;
+            }
+            const auto scorer = MakeScorer<TfIdfScorer>(word_it->second);
+            term_bounds.emplace_back();
+            for (const auto& [bucket, postings] : *word_segments) {
+                const double max_score = scorer(ImpactIndex::GetBucketMaxTermFreq(bucket), 0);
+                segments.push_back({max_score, scorer, term_bounds.size() - 1, &postings});
+                term_bounds.back().push_back(max_score);
+            }
+        }
+        }
+        std::stable_sort(segments.begin(), segments.end(), [](const SegmentRef& lhs, const SegmentRef& rhs) {
+            return lhs.max_score > rhs.max_score;
+        });
+
+        struct Accumulator {
+            double score = 0;
+            bool is_accepted = false;
+        };
+        std::pmr::unordered_map<int, Accumulator> accumulators(resource);
+        std::pmr::vector<size_t> processed_segments(term_bounds.size(), 0, resource);
+        double remaining_bound = 0;
+        for (const auto& bounds : term_bounds) {
+            remaining_bound += bounds.front();
+        }
+        const auto is_excluded = [this, &query](int document_id) {
+            return std::any_of(query.minus_words.begin(), query.minus_words.end(), [&](const std::string_view word) {
+                const auto it = word_to_document_freqs_.find(word);
+                return it != word_to_document_freqs_.end() && it->second.count(document_id) > 0;
+            });
+        };
+        // Once unseen documents cannot reach the k-th score no new accumulators are created,
+        // and the traversal stops when no document outside the top can overtake its k-th member.
+        // A document within DELTA of the k-th score ties with it and is ranked by rating and id,
+        // so it keeps the top unsettled
+        bool is_admission_closed = false;
+        // Reused between checks, the arena does not reclaim freed memory
+        std::pmr::vector<double> scores(resource);
+        const auto is_top_settled = [&]() {
+            scores.clear();
+            for (const auto& [_, accumulator] : accumulators) {
+                if (accumulator.is_accepted) {
+                    scores.push_back(accumulator.score);
+                }
+            }
+            if (scores.size() < static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)) {
+                return false;
+            }
+            std::nth_element(scores.begin(), scores.begin() + MAX_RESULT_DOCUMENT_COUNT - 1, scores.end(), std::greater<>());
+            const double kth_score = scores[MAX_RESULT_DOCUMENT_COUNT - 1];
+            const double best_outside = scores.size() > static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT)
+                ? *std::max_element(scores.begin() + MAX_RESULT_DOCUMENT_COUNT, scores.end())
+                : 0.0;
+            const double reachable = remaining_bound * (1.0 - options.score_slack);
+            is_admission_closed = reachable < kth_score - DELTA;
+            return best_outside + reachable < kth_score - DELTA;
+        };
+
+        {
+        TRACE_SCOPE("scoring");
+        size_t processed_postings = 0;
+        size_t postings_since_check = 0;
+        for (const SegmentRef& segment : segments) {
+            for (const auto& [document_id, term_freq] : *segment.postings) {
+                if (is_admission_closed) {
+                    const auto it = accumulators.find(document_id);
+                    if (it != accumulators.end() && it->second.is_accepted) {
+                        it->second.score += segment.scorer(term_freq, 0);
+                    }
+                    continue;
+                }
+                auto [it, is_new] = accumulators.try_emplace(document_id);
+                if (is_new) {
+                    const auto& document_data = documents_.at(document_id);
+                    it->second.is_accepted = document_predicate(document_id, document_data.status, document_data.rating)
+                                             && !is_excluded(document_id);
+                }
+                if (it->second.is_accepted) {
+                    it->second.score += segment.scorer(term_freq, 0);
+                }
+            }
+            processed_postings += segment.postings->size();
+            postings_since_check += segment.postings->size();
 
+            const auto& bounds = term_bounds[segment.term_index];
+            size_t& next = processed_segments[segment.term_index];
+            remaining_bound -= bounds[next];
+            ++next;
+            if (next < bounds.size()) {
+                remaining_bound += bounds[next];
+            }
+
+            if (processed_postings >= options.max_postings) {
+                break;
+            }
+            // The check is linear in the accumulators, so it runs once enough new work piled up
+            if (postings_since_check * 8 >= accumulators.size()) {
+                postings_since_check = 0;
+                if (is_top_settled()) {
+                    break;
+                }
+            }
+        }
+        }
+
+        TRACE_SCOPE("collect");
+        std::vector<Document> matched_documents;
+        for (const auto& [document_id, accumulator] : accumulators) {
+            if (accumulator.is_accepted) {
+                matched_documents.push_back({document_id, accumulator.score, documents_.at(document_id).rating});
+            }
+        }
+        // A settled top is ahead of every other document by more than DELTA, otherwise all
+        // scores are complete; either way ties are broken as in FindTopDocuments
+        const size_t top_count = std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+        std::partial_sort(matched_documents.begin(), matched_documents.begin() + top_count, matched_documents.end(), IsRankedBefore);
+        matched_documents.resize(top_count);
+        // Partial scores are lower bounds, finish the few survivors with point lookups
+        for (Document& document : matched_documents) {
+            document.relevance = 0;
+            for (const std::string_view word : query.plus_words) {
+                const auto word_it = word_to_document_freqs_.find(word);
+                if (word_it == word_to_document_freqs_.end()) {
+                    continue;
+                }
+                const auto it = word_it->second.find(document.id);
+                if (it != word_it->second.end()) {
+                    document.relevance += MakeScorer<TfIdfScorer>(word_it->second)(it->second, 0);
+                }
+            }
+        }
+        std::sort(matched_documents.begin(), matched_documents.end(), IsRankedBefore);
+        return matched_documents;
+}
@@ -1,7 +1,9 @@
 #include "string_processing.h"
 
-std::vector<std::string_view> SplitIntoWords(const std::string_view str) {
-  std::vector<std::string_view> result;
+namespace {
+
+template <typename Container>
+void AppendWords(const std::string_view str, Container& result) {
   int64_t pos = str.find_first_not_of(" ");
   const int64_t pos_end = str.npos;
   while (pos != pos_end) {
@@ -9,6 +11,18 @@ std::vector<std::string_view> SplitIntoWords(const std::string_view str) {
         result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
         pos = str.find_first_not_of(" ", space);
     }
+}
+
+}
+
+std::vector<std::string_view> SplitIntoWords(const std::string_view str) {
+  std::vector<std::string_view> result;
+  AppendWords(str, result);
+  return result;
+}
 
-    return result;
-}
\ No newline at end of file
+std::pmr::vector<std::string_view> SplitIntoWords(const std::string_view str, std::pmr::memory_resource* resource) {
+  std::pmr::vector<std::string_view> result(resource);
+  AppendWords(str, result);
+  return result;
+}
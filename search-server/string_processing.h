@@ -2,9 +2,12 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <memory_resource>
 
 std::vector<std::string_view> SplitIntoWords(const std::string_view str);
 
+std::pmr::vector<std::string_view> SplitIntoWords(const std::string_view str, std::pmr::memory_resource* resource);
+
 
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
@@ -0,0 +1,25 @@
+#include "term_dictionary.h"
+#include <iterator>
+
+void TermDictionary::Insert(std::string_view term) {
+    recent_terms_.insert(std::upper_bound(recent_terms_.begin(), recent_terms_.end(), term), term);
+    if (recent_terms_.size() * recent_terms_.size() > terms_.size() + 1024) {
+        Compact();
+    }
+}
+
+size_t TermDictionary::size() const {
+    return terms_.size() + recent_terms_.size();
+}
+
+StructureMemory TermDictionary::GetMemoryUsage() const {
+    return {size(), GetVectorHeapSize(terms_) + GetVectorHeapSize(recent_terms_)};
+}
+
+void TermDictionary::Compact() {
+    std::vector<std::string_view> merged;
+    merged.reserve(terms_.size() + recent_terms_.size());
+    std::merge(terms_.begin(), terms_.end(), recent_terms_.begin(), recent_terms_.end(), std::back_inserter(merged));
+    terms_ = std::move(merged);
+    recent_terms_.clear();
+}
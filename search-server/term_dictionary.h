@@ -0,0 +1,44 @@
+#pragma once
+#include "memory_stats.h"
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+// Sorted array of all indexed terms for prefix enumeration. New terms go to a small
+// sorted side array which is merged into the main one once it outgrows its square root,
+// so inserts stay cheap and lookups scan contiguous memory.
+class TermDictionary {
+public:
+    // The caller guarantees the term is not in the dictionary yet and outlives it
+    void Insert(std::string_view term);
+
+    template <typename Callback>
+    void ForEachWithPrefix(std::string_view prefix, Callback callback) const;
+
+    size_t size() const;
+
+    StructureMemory GetMemoryUsage() const;
+
+private:
+    template <typename Callback>
+    static void ScanPrefix(const std::vector<std::string_view>& terms, std::string_view prefix, Callback& callback);
+
+    void Compact();
+
+    std::vector<std::string_view> terms_;
+    std::vector<std::string_view> recent_terms_;
+};
+
+template <typename Callback>
+void TermDictionary::ScanPrefix(const std::vector<std::string_view>& terms, std::string_view prefix, Callback& callback) {
+    for (auto it = std::lower_bound(terms.begin(), terms.end(), prefix);
+         it != terms.end() && it->substr(0, prefix.size()) == prefix; ++it) {
+        callback(*it);
+    }
+}
+
+template <typename Callback>
+void TermDictionary::ForEachWithPrefix(std::string_view prefix, Callback callback) const {
+    ScanPrefix(terms_, prefix, callback);
+    ScanPrefix(recent_terms_, prefix, callback);
+}
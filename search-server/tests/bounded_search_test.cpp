@@ -0,0 +1,93 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+#include <chrono>
+#include <execution>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Build: g++ -std=c++17 -I.. bounded_search_test.cpp $(ls ../*.cpp | grep -v main.cpp) -ltbb -lpthread
+
+namespace {
+
+const vector<string> VOCABULARY = {"cat"s, "cats"s, "catfish"s, "dog"s, "dogs"s, "bird"s, "fish"s, "fox"s, "owl"s, "bat"s};
+
+// Plus words, minus words, required words, prefixes and phrases, alone and combined
+const vector<string> QUERIES = {"cat"s, "cat dog bird"s, "fish -owl"s, "+cat dog"s, "+cat +dog -owl fox"s, "cat*"s,
+                                "dog* fox -cats"s, "\"cat dog\""s, "bird \"fox owl\" -bat"s, "+fish \"cat dog\"~2"s};
+
+SearchServer MakeServer() {
+    SearchServerOptions options;
+    options.store_positions = true;
+    SearchServer server("and in"s, options);
+    mt19937 generator(48);
+    for (int id = 0; id < 3000; ++id) {
+        string text;
+        const int word_count = uniform_int_distribution(1, 10)(generator);
+        for (int i = 0; i < word_count; ++i) {
+            text += (i > 0 ? " "s : ""s) + VOCABULARY[uniform_int_distribution<size_t>(0, VOCABULARY.size() - 1)(generator)];
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {uniform_int_distribution(-5, 5)(generator)});
+    }
+    return server;
+}
+
+void AssertSameDocuments(const vector<Document>& expected, const vector<Document>& actual, const string& hint) {
+    AssertEqual(actual.size(), expected.size(), hint);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        AssertEqual(actual[i].id, expected[i].id, hint);
+        AssertEqual(actual[i].relevance, expected[i].relevance, hint);
+    }
+}
+
+// A budget that is not exhausted changes nothing, not even the rounding of the relevances
+template <typename ExecutionPolicy>
+void AssertUnboundedMatches(ExecutionPolicy&& policy, const SearchServer& server, const string& policy_name) {
+    for (const string& query : QUERIES) {
+        const string hint = policy_name + " query " + query;
+        const auto expected = server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL);
+        const auto result = server.FindTopDocuments(policy, query, DocumentStatus::ACTUAL, SearchBudget{});
+        Assert(!result.is_partial, hint);
+        Assert(result.postings_visited > 0 || expected.empty(), hint);
+        AssertSameDocuments(expected, result.documents, hint);
+    }
+}
+
+void TestUnboundedSearchMatchesFindTopDocuments() {
+    const SearchServer server = MakeServer();
+    AssertUnboundedMatches(execution::seq, server, "seq"s);
+    AssertUnboundedMatches(execution::par, server, "par"s);
+}
+
+// Every kind of query stops at max_postings, the conjunctive and phrase ones included
+void TestPostingsBudgetBoundsEveryQuery() {
+    const SearchServer server = MakeServer();
+    SearchBudget budget;
+    budget.max_postings = 100;
+    for (const string& query : QUERIES) {
+        const auto unbounded = server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, SearchBudget{});
+        const auto result = server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, budget);
+        Assert(result.postings_visited <= budget.max_postings, "query " + query);
+        AssertEqual(result.is_partial, unbounded.postings_visited > budget.max_postings, "query " + query);
+    }
+}
+
+void TestExpiredDeadlineStopsEveryQuery() {
+    const SearchServer server = MakeServer();
+    for (const string& query : QUERIES) {
+        const auto result = server.FindTopDocuments(execution::seq, query, DocumentStatus::ACTUAL, SearchBudget::WithTimeout(-1s));
+        Assert(result.is_partial, "query " + query);
+        Assert(result.documents.empty(), "query " + query);
+        AssertEqual(result.postings_visited, 0u, "query " + query);
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestUnboundedSearchMatchesFindTopDocuments);
+    RUN_TEST(tr, TestPostingsBudgetBoundsEveryQuery);
+    RUN_TEST(tr, TestExpiredDeadlineStopsEveryQuery);
+}
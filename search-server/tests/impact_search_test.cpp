@@ -0,0 +1,60 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Build: g++ -std=c++17 -I.. impact_search_test.cpp $(ls ../*.cpp | grep -v main.cpp) -ltbb -lpthread
+
+namespace {
+
+void AssertSameTop(const vector<Document>& expected, const vector<Document>& actual, const string& query) {
+    ASSERT_EQUAL(actual.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        const string hint = "query " + query + ", position " + to_string(i);
+        AssertEqual(actual[i].id, expected[i].id, hint);
+        AssertEqual(actual[i].rating, expected[i].rating, hint);
+        Assert(abs(actual[i].relevance - expected[i].relevance) < 1e-6, hint);
+    }
+}
+
+SearchServerOptions MakeImpactOptions() {
+    SearchServerOptions options;
+    options.store_impact_index = true;
+    return options;
+}
+
+// Documents of equal relevance are ranked by rating and then by id, as in FindTopDocuments
+void TestImpactSearchBreaksTiesLikeFindTopDocuments() {
+    SearchServer server("and in"s, MakeImpactOptions());
+    mt19937 generator(35);
+    for (int id = 0; id < 30; ++id) {
+        server.AddDocument(id, "cat dog"s, DocumentStatus::ACTUAL, {uniform_int_distribution(-5, 5)(generator)});
+    }
+    for (const string& query : {"cat"s, "dog"s, "cat dog"s, "cat -bird"s}) {
+        AssertSameTop(server.FindTopDocuments(query), server.FindTopDocumentsByImpact(query, DocumentStatus::ACTUAL), query);
+    }
+}
+
+// Ties at the boundary of the top must not end the traversal early
+void TestImpactSearchTiesAcrossSegments() {
+    SearchServer server("and in"s, MakeImpactOptions());
+    mt19937 generator(36);
+    const vector<string> texts = {"cat"s, "cat dog"s, "cat cat dog"s, "cat dog bird fish"s, "dog bird"s};
+    for (int id = 0; id < 200; ++id) {
+        const string& text = texts[uniform_int_distribution<size_t>(0, texts.size() - 1)(generator)];
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {uniform_int_distribution(0, 3)(generator)});
+    }
+    for (const string& query : {"cat"s, "dog"s, "cat dog"s, "bird fish"s, "cat bird -fish"s}) {
+        AssertSameTop(server.FindTopDocuments(query), server.FindTopDocumentsByImpact(query, DocumentStatus::ACTUAL), query);
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestImpactSearchBreaksTiesLikeFindTopDocuments);
+    RUN_TEST(tr, TestImpactSearchTiesAcrossSegments);
+}
@@ -0,0 +1,64 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Build: g++ -std=c++17 -I.. lean_index_test.cpp $(ls ../*.cpp | grep -v main.cpp) -ltbb -lpthread
+
+namespace {
+
+const vector<string> TEXTS = {"cat and dog in the city"s, "dog dog bird"s, "fish owl cat cat"s, "bird in the nest"s};
+
+map<string, double> ToOwnedWords(const map<string_view, double>& word_frequencies) {
+    return {word_frequencies.begin(), word_frequencies.end()};
+}
+
+// The regular index keeps the maps, the lean one has to give the same answers
+void AssertSameWordFrequencies(const SearchServer& expected, const SearchServer& lean, int document_id) {
+    const string hint = "document " + to_string(document_id);
+    AssertEqual(ToOwnedWords(lean.GetWordFrequencies(document_id)), ToOwnedWords(expected.GetWordFrequencies(document_id)), hint);
+    AssertEqual(ToOwnedWords(lean.CopyWordFrequencies(document_id)), ToOwnedWords(expected.GetWordFrequencies(document_id)), hint);
+}
+
+void TestLeanWordFrequenciesFollowRemovalsAndUpdates() {
+    SearchServerOptions lean_options;
+    lean_options.lean_index = true;
+    SearchServer lean("and in the"s, lean_options);
+    SearchServer regular("and in the"s);
+    for (int id = 0; id < static_cast<int>(TEXTS.size()); ++id) {
+        lean.AddDocument(id, TEXTS[id], DocumentStatus::ACTUAL, {id});
+        regular.AddDocument(id, TEXTS[id], DocumentStatus::ACTUAL, {id});
+    }
+    for (int id = 0; id < static_cast<int>(TEXTS.size()); ++id) {
+        AssertSameWordFrequencies(regular, lean, id);
+    }
+    // Each document has a map of its own that outlives later calls
+    const auto& first = lean.GetWordFrequencies(0);
+    const auto& second = lean.GetWordFrequencies(1);
+    Assert(&first != &second, "distinct maps"s);
+    ASSERT_EQUAL(ToOwnedWords(first), ToOwnedWords(regular.GetWordFrequencies(0)));
+
+    lean.RemoveDocument(1);
+    regular.RemoveDocument(1);
+    Assert(lean.GetWordFrequencies(1).empty(), "removed document"s);
+    ASSERT_EQUAL(ToOwnedWords(first), ToOwnedWords(regular.GetWordFrequencies(0)));
+
+    lean.UpdateDocument(2, "owl owl fox"s, DocumentStatus::ACTUAL, {5});
+    regular.UpdateDocument(2, "owl owl fox"s, DocumentStatus::ACTUAL, {5});
+    for (const int id : {0, 1, 2, 3}) {
+        AssertSameWordFrequencies(regular, lean, id);
+    }
+    // A removed id can be indexed again with other words
+    lean.AddDocument(1, "fox cat"s, DocumentStatus::ACTUAL, {1});
+    regular.AddDocument(1, "fox cat"s, DocumentStatus::ACTUAL, {1});
+    AssertSameWordFrequencies(regular, lean, 1);
+}
+
+}  // namespace
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestLeanWordFrequenciesFollowRemovalsAndUpdates);
+}
@@ -0,0 +1,103 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Build: g++ -std=c++17 -I.. query_allocation_test.cpp $(ls ../*.cpp | grep -v main.cpp) -ltbb -lpthread
+// Replaces the global allocation functions, so it is a binary of its own
+
+namespace {
+
+atomic<size_t> heap_allocation_count{0};
+
+}  // namespace
+
+// Out of line, so that GCC does not match the free against the operator new it inlines
+// into callers and warn about a mismatched deallocation
+__attribute__((noinline)) void* operator new(size_t size) {
+    heap_allocation_count.fetch_add(1, memory_order_relaxed);
+    if (void* ptr = malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+const vector<string> VOCABULARY = {"cat"s, "cats"s, "catfish"s, "dog"s, "dogs"s, "bird"s, "fish"s, "fox"s, "owl"s, "bat"s, "elk"s, "emu"s};
+
+SearchServer MakeServer(const SearchServerOptions& options) {
+    SearchServer server("and in"s, options);
+    mt19937 generator(36);
+    for (int id = 0; id < 2000; ++id) {
+        string text;
+        const int word_count = uniform_int_distribution(1, 8)(generator);
+        for (int i = 0; i < word_count; ++i) {
+            text += (i > 0 ? " "s : ""s) + VOCABULARY[uniform_int_distribution<size_t>(0, VOCABULARY.size() - 1)(generator)];
+        }
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, {uniform_int_distribution(-5, 5)(generator)});
+    }
+    return server;
+}
+
+// A query evaluated a second time with the same result vector must not allocate: the
+// first evaluation grows the thread's QueryArena and the vector to what the query needs
+template <typename ExecutionPolicy>
+void AssertWarmQueryDoesNotAllocate(ExecutionPolicy&& policy, const SearchServer& server, const string& query) {
+    vector<Document> documents;
+    server.FindTopDocumentsPage(policy, query, DocumentStatus::ACTUAL, 0, MAX_RESULT_DOCUMENT_COUNT, documents);
+    const size_t allocations_before = heap_allocation_count.load(memory_order_relaxed);
+    server.FindTopDocumentsPage(policy, query, DocumentStatus::ACTUAL, 0, MAX_RESULT_DOCUMENT_COUNT, documents);
+    const size_t allocations = heap_allocation_count.load(memory_order_relaxed) - allocations_before;
+    AssertEqual(allocations, 0u, "query " + query);
+}
+
+const vector<string> QUERIES = {"cat"s, "cat dog bird"s, "cat -dog"s, "+cat dog"s, "+cat +dog -owl"s, "cat*"s,
+                                "dog* -cats"s, "nonexistent"s, "cat cat cat dog"s};
+
+void TestSequentialQueryDoesNotAllocate() {
+    const SearchServer server = MakeServer({});
+    for (const string& query : QUERIES) {
+        AssertWarmQueryDoesNotAllocate(execution::seq, server, query);
+    }
+}
+
+void TestPhraseQueryDoesNotAllocate() {
+    SearchServerOptions options;
+    options.store_positions = true;
+    const SearchServer server = MakeServer(options);
+    for (const string& query : {"\"cat dog\""s, "bird \"cat dog\" -owl"s, "\"fox owl\"~3"s}) {
+        AssertWarmQueryDoesNotAllocate(execution::seq, server, query);
+    }
+}
+
+void TestLeanQueryDoesNotAllocate() {
+    SearchServerOptions options;
+    options.lean_index = true;
+    const SearchServer server = MakeServer(options);
+    for (const string& query : QUERIES) {
+        AssertWarmQueryDoesNotAllocate(execution::seq, server, query);
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestSequentialQueryDoesNotAllocate);
+    RUN_TEST(tr, TestPhraseQueryDoesNotAllocate);
+    RUN_TEST(tr, TestLeanQueryDoesNotAllocate);
+}
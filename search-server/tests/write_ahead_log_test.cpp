@@ -0,0 +1,202 @@
+#include "../search_server.h"
+#include "../test_framework.h"
+#include "../write_ahead_log.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+using namespace std;
+
+// Build: g++ -std=c++17 -I.. write_ahead_log_test.cpp $(ls ../*.cpp | grep -v main.cpp) -ltbb -lpthread
+
+namespace {
+
+const string STOP_WORDS = "and in"s;
+const vector<string> VOCABULARY = {"cat"s, "dog"s, "bird"s, "fish"s, "fox"s, "owl"s, "bat"s, "elk"s};
+
+using Operation = function<void(SearchServer&)>;
+
+// Status, rating and term frequencies of every document
+using IndexSnapshot = map<int, tuple<DocumentStatus, int, map<string, double>>>;
+
+IndexSnapshot TakeSnapshot(SearchServer& server) {
+    IndexSnapshot snapshot;
+    for (const int document_id : server) {
+        const auto& word_frequencies = server.GetWordFrequencies(document_id);
+        get<2>(snapshot[document_id]) = {word_frequencies.begin(), word_frequencies.end()};
+    }
+    // Status and rating are only visible to search predicates
+    for (const string& word : VOCABULARY) {
+        server.FindTopDocuments(execution::seq, word, [&snapshot](int document_id, DocumentStatus status, int rating) {
+            get<0>(snapshot[document_id]) = status;
+            get<1>(snapshot[document_id]) = rating;
+            return false;
+        });
+    }
+    return snapshot;
+}
+
+string GenerateText(mt19937& generator) {
+    string text;
+    const int word_count = uniform_int_distribution(1, 6)(generator);
+    for (int i = 0; i < word_count; ++i) {
+        text += (i > 0 ? " "s : ""s) + VOCABULARY[uniform_int_distribution<size_t>(0, VOCABULARY.size() - 1)(generator)];
+        if (uniform_int_distribution(0, 4)(generator) == 0) {
+            text += " and"s;
+        }
+    }
+    return text;
+}
+
+// Adds, removals, text updates and attribute updates in random order, each valid for the
+// documents indexed by the operations before it
+vector<Operation> GenerateOperations(mt19937& generator, int count) {
+    vector<Operation> operations;
+    vector<int> document_ids;
+    int next_id = 0;
+    for (int i = 0; i < count; ++i) {
+        const int kind = document_ids.empty() ? 0 : uniform_int_distribution(0, 3)(generator);
+        const auto status = static_cast<DocumentStatus>(uniform_int_distribution(0, 3)(generator));
+        const vector<int> ratings = {uniform_int_distribution(-10, 10)(generator)};
+        if (kind == 0) {
+            const string text = GenerateText(generator);
+            const int document_id = next_id++;
+            document_ids.push_back(document_id);
+            operations.push_back([=](SearchServer& server) { server.AddDocument(document_id, text, status, ratings); });
+            continue;
+        }
+        const size_t index = uniform_int_distribution<size_t>(0, document_ids.size() - 1)(generator);
+        const int document_id = document_ids[index];
+        if (kind == 1) {
+            document_ids.erase(document_ids.begin() + index);
+            operations.push_back([=](SearchServer& server) { server.RemoveDocument(document_id); });
+        } else if (kind == 2) {
+            const string text = GenerateText(generator);
+            operations.push_back([=](SearchServer& server) { server.UpdateDocument(document_id, text, status, ratings); });
+        } else {
+            operations.push_back([=](SearchServer& server) { server.UpdateDocument(document_id, status, ratings); });
+        }
+    }
+    return operations;
+}
+
+IndexSnapshot BuildReference(const vector<Operation>& operations, size_t count, const SearchServerOptions& options) {
+    SearchServerOptions reference_options = options;
+    reference_options.write_ahead_log = nullptr;
+    SearchServer server(STOP_WORDS, reference_options);
+    for (size_t i = 0; i < count; ++i) {
+        operations[i](server);
+    }
+    return TakeSnapshot(server);
+}
+
+string ReadFile(const string& path) {
+    ifstream input(path, ios::binary);
+    return {istreambuf_iterator<char>(input), istreambuf_iterator<char>()};
+}
+
+void WriteFile(const string& path, const string& contents) {
+    ofstream output(path, ios::binary | ios::trunc);
+    output << contents;
+}
+
+// Damages a log of known record boundaries at random, replays it and checks that exactly
+// the records before the damage are applied and that appends continue after them
+void TestRecoveryFromDamagedLog(const SearchServerOptions& options, unsigned seed) {
+    const string path = (filesystem::temp_directory_path() / ("search_server_wal_test_"s + to_string(seed))).string();
+    remove(path.c_str());
+    WriteAheadLogOptions log_options;
+    log_options.sync = false;
+
+    mt19937 generator(seed);
+    const vector<Operation> operations = GenerateOperations(generator, 80);
+    vector<size_t> record_ends;
+    {
+        SearchServerOptions logged_options = options;
+        logged_options.write_ahead_log = make_shared<WriteAheadLog>(path, log_options);
+        SearchServer server(STOP_WORDS, logged_options);
+        for (const Operation& operation : operations) {
+            operation(server);
+            record_ends.push_back(filesystem::file_size(path));
+        }
+    }
+    const string log = ReadFile(path);
+    ASSERT_EQUAL(log.size(), record_ends.back());
+
+    for (int trial = 0; trial < 40; ++trial) {
+        string damaged = log.substr(0, uniform_int_distribution<size_t>(0, log.size())(generator));
+        size_t valid_size = damaged.size();
+        if (!damaged.empty() && trial % 2 == 0) {
+            const size_t offset = uniform_int_distribution<size_t>(0, damaged.size() - 1)(generator);
+            damaged[offset] ^= static_cast<char>(uniform_int_distribution(1, 255)(generator));
+            valid_size = offset;
+        }
+        const size_t surviving_count = upper_bound(record_ends.begin(), record_ends.end(), valid_size) - record_ends.begin();
+        const size_t surviving_size = surviving_count == 0 ? 0 : record_ends[surviving_count - 1];
+        const string hint = "seed " + to_string(seed) + ", trial " + to_string(trial);
+        WriteFile(path, damaged);
+
+        const Operation appended = [](SearchServer& server) { server.AddDocument(1000, "cat owl"s, DocumentStatus::ACTUAL, {7}); };
+        {
+            SearchServerOptions replay_options = options;
+            replay_options.write_ahead_log = make_shared<WriteAheadLog>(path, log_options);
+            AssertEqual(replay_options.write_ahead_log->GetRecoveredSize(), surviving_size, hint);
+            AssertEqual(replay_options.write_ahead_log->GetDiscardedSize(), damaged.size() - surviving_size, hint);
+            SearchServer server(STOP_WORDS, replay_options);
+            AssertEqual(server.ReplayWriteAheadLog(), surviving_count, hint);
+            AssertEqual(TakeSnapshot(server) == BuildReference(operations, surviving_count, options), true, hint);
+            appended(server);
+        }
+        // The damaged tail was cut off, so the new record directly follows the surviving ones
+        SearchServerOptions reopened_options = options;
+        reopened_options.write_ahead_log = make_shared<WriteAheadLog>(path, log_options);
+        AssertEqual(reopened_options.write_ahead_log->GetDiscardedSize(), 0u, hint);
+        SearchServer server(STOP_WORDS, reopened_options);
+        AssertEqual(server.ReplayWriteAheadLog(), surviving_count + 1, hint);
+        vector<Operation> expected_operations(operations.begin(), operations.begin() + surviving_count);
+        expected_operations.push_back(appended);
+        AssertEqual(TakeSnapshot(server) == BuildReference(expected_operations, expected_operations.size(), options), true, hint);
+    }
+    remove(path.c_str());
+}
+
+void TestWriteAheadLogRecovery() {
+    for (unsigned seed = 1; seed <= 5; ++seed) {
+        TestRecoveryFromDamagedLog({}, seed);
+    }
+}
+
+// Logged terms are replayed without tokenising, lean servers copy them into the dictionary
+void TestWriteAheadLogRecoveryLean() {
+    SearchServerOptions options;
+    options.lean_index = true;
+    for (unsigned seed = 11; seed <= 15; ++seed) {
+        TestRecoveryFromDamagedLog(options, seed);
+    }
+}
+
+// Positions are not logged, so these servers tokenise the logged texts again
+void TestWriteAheadLogRecoveryWithPositions() {
+    SearchServerOptions options;
+    options.store_positions = true;
+    for (unsigned seed = 21; seed <= 25; ++seed) {
+        TestRecoveryFromDamagedLog(options, seed);
+    }
+}
+
+}  // namespace
+
+int main() {
+    TestRunner tr;
+    RUN_TEST(tr, TestWriteAheadLogRecovery);
+    RUN_TEST(tr, TestWriteAheadLogRecoveryLean);
+    RUN_TEST(tr, TestWriteAheadLogRecoveryWithPositions);
+}
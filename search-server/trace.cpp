@@ -0,0 +1,142 @@
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+
+std::mutex Tracer::registry_mutex_;
+std::vector<std::shared_ptr<Tracer::ThreadBuffer>> Tracer::registry_;
+
+namespace {
+
+int GetHistogramBucket(uint64_t duration_ns) {
+    int bucket = 0;
+    while (duration_ns > 0 && bucket < TRACE_HISTOGRAM_BUCKET_COUNT - 1) {
+        duration_ns >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+void MergeSummary(TraceSummary& dst, const TraceSummary& src) {
+    dst.count += src.count;
+    dst.total_ns += src.total_ns;
+    dst.max_ns = std::max(dst.max_ns, src.max_ns);
+    for (int i = 0; i < TRACE_HISTOGRAM_BUCKET_COUNT; ++i) {
+        dst.histogram[i] += src.histogram[i];
+    }
+}
+
+}  // namespace
+
+uint64_t TraceSummary::GetPercentile(double quantile) const {
+    const uint64_t rank = static_cast<uint64_t>(quantile * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < TRACE_HISTOGRAM_BUCKET_COUNT; ++i) {
+        seen += histogram[i];
+        if (seen > rank) {
+            return std::min(uint64_t{1} << i, max_ns);
+        }
+    }
+    return max_ns;
+}
+
+uint64_t Tracer::NowNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto result = std::make_shared<ThreadBuffer>();
+        std::lock_guard guard(registry_mutex_);
+        result->thread_id = registry_.size() + 1;
+        registry_.push_back(result);
+        return result;
+    }();
+    return *buffer;
+}
+
+uint32_t Tracer::EnterScope() {
+    return GetThreadBuffer().depth++;
+}
+
+void Tracer::Record(const char* name, uint64_t start_ns, uint64_t duration_ns) {
+    ThreadBuffer& buffer = GetThreadBuffer();
+    std::lock_guard guard(buffer.mutex);
+    --buffer.depth;
+    if (buffer.events.size() < MAX_EVENTS_PER_THREAD) {
+        buffer.events.push_back({name, start_ns, duration_ns, buffer.depth});
+    }
+    auto it = std::find_if(buffer.summaries.begin(), buffer.summaries.end(),
+                           [name](const TraceSummary& summary) { return summary.name == name; });
+    if (it == buffer.summaries.end()) {
+        it = buffer.summaries.insert(buffer.summaries.end(), TraceSummary{});
+        it->name = name;
+    }
+    ++it->count;
+    it->total_ns += duration_ns;
+    it->max_ns = std::max(it->max_ns, duration_ns);
+    ++it->histogram[GetHistogramBucket(duration_ns)];
+}
+
+void Tracer::ExportChromeTrace(std::ostream& out) {
+    std::lock_guard registry_guard(registry_mutex_);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    out << std::fixed << std::setprecision(3);
+    for (const auto& buffer : registry_) {
+        std::lock_guard guard(buffer->mutex);
+        for (const TraceEvent& event : buffer->events) {
+            if (!first) {
+                out << ',';
+            }
+            first = false;
+            out << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+                << ",\"ts\":" << event.start_ns / 1000.0 << ",\"dur\":" << event.duration_ns / 1000.0
+                << ",\"args\":{\"depth\":" << event.depth << "}}";
+        }
+    }
+    out << "\n],\"displayTimeUnit\":\"ns\"}" << std::endl;
+}
+
+std::vector<TraceSummary> Tracer::GetSummaries() {
+    std::vector<TraceSummary> result;
+    std::lock_guard registry_guard(registry_mutex_);
+    for (const auto& buffer : registry_) {
+        std::lock_guard guard(buffer->mutex);
+        for (const TraceSummary& summary : buffer->summaries) {
+            auto it = std::find_if(result.begin(), result.end(), [&summary](const TraceSummary& merged) {
+                return std::strcmp(merged.name, summary.name) == 0;
+            });
+            if (it == result.end()) {
+                result.push_back(summary);
+            } else {
+                MergeSummary(*it, summary);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const TraceSummary& lhs, const TraceSummary& rhs) {
+        return lhs.total_ns > rhs.total_ns;
+    });
+    return result;
+}
+
+void Tracer::PrintSummary(std::ostream& out) {
+    for (const TraceSummary& summary : GetSummaries()) {
+        out << summary.name << ": count = " << summary.count
+            << ", total = " << summary.total_ns << " ns"
+            << ", mean = " << summary.total_ns / std::max<uint64_t>(summary.count, 1) << " ns"
+            << ", p50 = " << summary.GetPercentile(0.5) << " ns"
+            << ", p99 = " << summary.GetPercentile(0.99) << " ns"
+            << ", max = " << summary.max_ns << " ns" << std::endl;
+    }
+}
+
+void Tracer::Clear() {
+    std::lock_guard registry_guard(registry_mutex_);
+    for (const auto& buffer : registry_) {
+        std::lock_guard guard(buffer->mutex);
+        buffer->events.clear();
+        buffer->summaries.clear();
+    }
+}
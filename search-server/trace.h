@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define TRACE_CONCAT_INTERNAL(X, Y) X##Y
+#define TRACE_CONCAT(X, Y) TRACE_CONCAT_INTERNAL(X, Y)
+
+/**
+ * Макрос замеряет время (в наносекундах) от своего вызова до конца текущего блока
+ * и сохраняет его в буфер текущего потока. Вложенные TRACE_SCOPE образуют иерархию.
+ * Имя должно быть строковым литералом: хранится только указатель.
+ *
+ * Трассировка включается при компиляции с -DSEARCH_SERVER_TRACING,
+ * без этого флага макрос ничего не генерирует.
+ * TRACE_SCOPE_DETAILED предназначен для горячих циклов (на каждый элемент)
+ * и включается отдельно флагом -DSEARCH_SERVER_TRACING_DETAILED.
+ *
+ * Пример использования:
+ *
+ *  void Task() {
+ *      TRACE_SCOPE("task");
+ *      ...
+ *  }
+ *
+ *  int main() {
+ *      Task();
+ *      std::ofstream trace_file("trace.json");
+ *      Tracer::ExportChromeTrace(trace_file);
+ *      Tracer::PrintSummary(std::cerr);
+ *  }
+ */
+#ifdef SEARCH_SERVER_TRACING
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) static_cast<void>(0)
+#endif
+
+#if defined(SEARCH_SERVER_TRACING) && defined(SEARCH_SERVER_TRACING_DETAILED)
+#define TRACE_SCOPE_DETAILED(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE_DETAILED(name) static_cast<void>(0)
+#endif
+
+constexpr int TRACE_HISTOGRAM_BUCKET_COUNT = 40;
+
+struct TraceEvent {
+    const char* name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    uint32_t depth;
+};
+
+// Aggregated timings of one named scope, bucket i counts durations below 2^i ns
+struct TraceSummary {
+    const char* name = nullptr;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    std::array<uint64_t, TRACE_HISTOGRAM_BUCKET_COUNT> histogram{};
+
+    uint64_t GetPercentile(double quantile) const;
+};
+
+class Tracer {
+public:
+    // Raw events kept per thread; summaries keep counting after the limit is reached
+    static constexpr size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    static uint64_t NowNs();
+
+    static void Record(const char* name, uint64_t start_ns, uint64_t duration_ns);
+
+    static uint32_t EnterScope();
+
+    static void ExportChromeTrace(std::ostream& out);
+
+    static std::vector<TraceSummary> GetSummaries();
+
+    static void PrintSummary(std::ostream& out);
+
+    static void Clear();
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;
+        uint64_t thread_id = 0;
+        uint32_t depth = 0;
+        std::vector<TraceEvent> events;
+        std::vector<TraceSummary> summaries;
+    };
+
+    static ThreadBuffer& GetThreadBuffer();
+
+    static std::mutex registry_mutex_;
+    static std::vector<std::shared_ptr<ThreadBuffer>> registry_;
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : name_(name)
+        , start_ns_((Tracer::EnterScope(), Tracer::NowNs())) {
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    ~TraceScope() {
+        Tracer::Record(name_, start_ns_, Tracer::NowNs() - start_ns_);
+    }
+
+private:
+    const char* name_;
+    const uint64_t start_ns_;
+};
@@ -0,0 +1,288 @@
+#include "write_ahead_log.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);  // payload length, CRC32
+
+using CrcTables = std::array<std::array<uint32_t, 256>, 8>;
+
+// tables[k][b] is the CRC of byte b followed by k zero bytes
+CrcTables MakeCrcTables() {
+    CrcTables tables{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        tables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i) {
+        for (size_t k = 1; k < tables.size(); ++k) {
+            tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+        }
+    }
+    return tables;
+}
+
+// Slicing-by-8, eight bytes per step; the word loads assume a little-endian machine
+uint32_t ComputeCrc32(std::string_view data) {
+    static const CrcTables tables = MakeCrcTables();
+    uint32_t crc = 0xFFFFFFFFu;
+    const char* ptr = data.data();
+    size_t size = data.size();
+    while (size >= 8) {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, ptr, sizeof(low));
+        std::memcpy(&high, ptr + 4, sizeof(high));
+        low ^= crc;
+        crc = tables[7][low & 0xFF] ^ tables[6][(low >> 8) & 0xFF] ^ tables[5][(low >> 16) & 0xFF] ^ tables[4][low >> 24]
+            ^ tables[3][high & 0xFF] ^ tables[2][(high >> 8) & 0xFF] ^ tables[1][(high >> 16) & 0xFF] ^ tables[0][high >> 24];
+        ptr += 8;
+        size -= 8;
+    }
+    for (; size > 0; ++ptr, --size) {
+        crc = tables[0][(crc ^ static_cast<uint8_t>(*ptr)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void Put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Bounds-checked reader over a payload
+class Reader {
+public:
+    explicit Reader(std::string_view data)
+        : data_(data) {
+    }
+
+    template <typename T>
+    bool Get(T& value) {
+        if (data_.size() < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data_.data(), sizeof(T));
+        data_.remove_prefix(sizeof(T));
+        return true;
+    }
+
+    bool GetBytes(size_t size, std::string_view& value) {
+        if (data_.size() < size) {
+            return false;
+        }
+        value = data_.substr(0, size);
+        data_.remove_prefix(size);
+        return true;
+    }
+
+    bool AtEnd() const {
+        return data_.empty();
+    }
+
+private:
+    std::string_view data_;
+};
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+WriteAheadLog::WriteAheadLog(const std::string& path, const WriteAheadLogOptions& options)
+    : path_(path)
+    , options_(options)
+{
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        ThrowSystemError("Cannot open write-ahead log " + path);
+    }
+    std::string contents;
+    char buffer[1 << 16];
+    while (true) {
+        const ssize_t count = ::read(fd_, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            const int error = errno;
+            ::close(fd_);
+            errno = error;
+            ThrowSystemError("Cannot read write-ahead log " + path);
+        }
+        if (count == 0) {
+            break;
+        }
+        contents.append(buffer, count);
+    }
+
+    const size_t valid_size = ForEachRecord(contents, [](const WalRecord&) {});
+    discarded_size_ = contents.size() - valid_size;
+    if (discarded_size_ > 0 && ::ftruncate(fd_, valid_size) != 0) {
+        const int error = errno;
+        ::close(fd_);
+        errno = error;
+        ThrowSystemError("Cannot truncate write-ahead log " + path);
+    }
+    contents.resize(valid_size);
+    recovered_ = std::move(contents);
+    recovered_size_ = valid_size;
+    file_size_ = valid_size;
+    ::lseek(fd_, file_size_, SEEK_SET);
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        Flush();
+    } catch (const std::system_error&) {
+        // Nothing sensible to do in a destructor, the records are lost like in a crash
+    }
+    ::close(fd_);
+}
+
+void WriteAheadLog::Append(const WalRecord& record) {
+    const size_t frame_begin = pending_.size();
+    pending_.resize(frame_begin + FRAME_HEADER_SIZE);
+    const size_t payload_begin = pending_.size();
+    Put(pending_, static_cast<uint8_t>(record.type));
+    Put(pending_, static_cast<int32_t>(record.document_id));
+    if (record.type == WalRecordType::SET_ATTRIBUTES) {
+        Put(pending_, static_cast<uint8_t>(record.status));
+        Put(pending_, static_cast<int32_t>(record.rating));
+    } else if (record.type == WalRecordType::ADD_DOCUMENT || record.type == WalRecordType::UPDATE_DOCUMENT) {
+        Put(pending_, static_cast<uint8_t>(record.status));
+        Put(pending_, static_cast<int32_t>(record.rating));
+        Put(pending_, record.tokenizer_fingerprint);
+        Put(pending_, record.word_count);
+        Put(pending_, static_cast<uint32_t>(record.text.size()));
+        pending_.append(record.text);
+        Put(pending_, static_cast<uint32_t>(record.terms.size()));
+        for (const WalTerm& term : record.terms) {
+            Put(pending_, term.offset);
+            Put(pending_, term.length);
+            Put(pending_, term.count);
+        }
+    }
+    const std::string_view payload = std::string_view(pending_).substr(payload_begin);
+    const uint32_t header[] = {static_cast<uint32_t>(payload.size()), ComputeCrc32(payload)};
+    std::memcpy(pending_.data() + frame_begin, header, sizeof(header));
+
+    ++pending_records_;
+    if (pending_records_ >= options_.group_commit_records || pending_.size() >= options_.group_commit_bytes) {
+        Flush();
+    }
+}
+
+void WriteAheadLog::Flush() {
+    if (pending_.empty()) {
+        return;
+    }
+    size_t written = 0;
+    while (written < pending_.size()) {
+        const ssize_t count = ::write(fd_, pending_.data() + written, pending_.size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            // Cut off the partially written group, it stays pending for the next attempt
+            const int error = errno;
+            if (::ftruncate(fd_, file_size_) == 0) {
+                ::lseek(fd_, file_size_, SEEK_SET);
+            }
+            errno = error;
+            ThrowSystemError("Cannot write to write-ahead log " + path_);
+        }
+        written += count;
+    }
+    if (options_.sync && ::fdatasync(fd_) != 0) {
+        ThrowSystemError("Cannot sync write-ahead log " + path_);
+    }
+    file_size_ += pending_.size();
+    pending_.clear();
+    pending_records_ = 0;
+}
+
+std::string WriteAheadLog::TakeRecoveredRecords() {
+    return std::move(recovered_);
+}
+
+size_t WriteAheadLog::GetRecoveredSize() const {
+    return recovered_size_;
+}
+
+size_t WriteAheadLog::GetDiscardedSize() const {
+    return discarded_size_;
+}
+
+bool WriteAheadLog::TryParseRecord(std::string_view data, size_t& pos, WalRecord& record, bool verify_checksum) {
+    if (data.size() - pos < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    uint32_t header[2];
+    std::memcpy(header, data.data() + pos, sizeof(header));
+    const size_t payload_size = header[0];
+    if (data.size() - pos - FRAME_HEADER_SIZE < payload_size) {
+        return false;
+    }
+    const std::string_view payload = data.substr(pos + FRAME_HEADER_SIZE, payload_size);
+    if (verify_checksum && ComputeCrc32(payload) != header[1]) {
+        return false;
+    }
+
+    Reader reader(payload);
+    uint8_t type;
+    int32_t document_id;
+    if (!reader.Get(type) || !reader.Get(document_id)) {
+        return false;
+    }
+    record.type = static_cast<WalRecordType>(type);
+    record.document_id = document_id;
+    record.terms.clear();
+    if (record.type == WalRecordType::SET_ATTRIBUTES) {
+        uint8_t status;
+        int32_t rating;
+        if (!reader.Get(status) || !reader.Get(rating)) {
+            return false;
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        record.rating = rating;
+    } else if (record.type == WalRecordType::ADD_DOCUMENT || record.type == WalRecordType::UPDATE_DOCUMENT) {
+        uint8_t status;
+        int32_t rating;
+        uint32_t text_size;
+        uint32_t term_count;
+        if (!reader.Get(status) || !reader.Get(rating) || !reader.Get(record.tokenizer_fingerprint)
+            || !reader.Get(record.word_count) || !reader.Get(text_size) || !reader.GetBytes(text_size, record.text)
+            || !reader.Get(term_count)) {
+            return false;
+        }
+        if (term_count > payload.size() / (3 * sizeof(uint32_t))) {
+            return false;
+        }
+        record.status = static_cast<DocumentStatus>(status);
+        record.rating = rating;
+        record.terms.resize(term_count);
+        for (WalTerm& term : record.terms) {
+            if (!reader.Get(term.offset) || !reader.Get(term.length) || !reader.Get(term.count)
+                || term.offset > text_size || term.length > text_size - term.offset) {
+                return false;
+            }
+        }
+    } else if (record.type != WalRecordType::REMOVE_DOCUMENT) {
+        return false;
+    }
+    if (!reader.AtEnd()) {
+        return false;
+    }
+    pos += FRAME_HEADER_SIZE + payload_size;
+    return true;
+}
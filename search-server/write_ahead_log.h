@@ -0,0 +1,102 @@
+#pragma once
+#include "document.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct WriteAheadLogOptions {
+    // Records are buffered and written with one write (and one fsync) once this many
+    // are pending or they take group_commit_bytes; 1 makes every mutation durable at once
+    size_t group_commit_records = 1;
+    size_t group_commit_bytes = 1 << 20;
+    // fdatasync after every group write; without it a written group survives a crash
+    // of the process but not of the machine
+    bool sync = true;
+};
+
+enum class WalRecordType : uint8_t {
+    ADD_DOCUMENT = 1,
+    REMOVE_DOCUMENT = 2,
+    UPDATE_DOCUMENT = 3,  // replaces the text, status and rating, same fields as ADD_DOCUMENT
+    SET_ATTRIBUTES = 4,  // replaces status and rating only
+};
+
+// A distinct term of a logged document: where one of its occurrences is in the text
+// and how many non-stop words of the document it makes up
+struct WalTerm {
+    uint32_t offset;
+    uint32_t length;
+    uint32_t count;
+};
+
+struct WalRecord {
+    WalRecordType type = WalRecordType::ADD_DOCUMENT;
+    int document_id = 0;
+    // The rest is only set for ADD_DOCUMENT and UPDATE_DOCUMENT, status and rating also
+    // for SET_ATTRIBUTES
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int rating = 0;
+    // Identifies the stop words the terms were produced with
+    uint64_t tokenizer_fingerprint = 0;
+    uint32_t word_count = 0;  // non-stop words
+    std::string_view text;
+    std::vector<WalTerm> terms;  // sorted by term
+};
+
+// Append-only binary log of index mutations. Every record is framed by its length and a
+// CRC32 of the payload, integers are stored in native byte order. Opening a log reads it,
+// keeps the records for replay and cuts off a torn or corrupt tail, so appends continue
+// right after the last complete record.
+class WriteAheadLog {
+public:
+    WriteAheadLog(const std::string& path, const WriteAheadLogOptions& options = {});
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    void Append(const WalRecord& record);
+
+    // Writes the pending group, throws std::system_error on I/O errors
+    void Flush();
+
+    // The complete records found on open, handed over once; parse with ForEachRecord
+    std::string TakeRecoveredRecords();
+
+    // Bytes of the complete records found on open and of the ones cut off
+    size_t GetRecoveredSize() const;
+    size_t GetDiscardedSize() const;
+
+    // Calls callback(const WalRecord&) for the complete records at the start of data,
+    // the record object is reused; returns the number of bytes consumed. Checksums of
+    // records that came from TakeRecoveredRecords were verified already.
+    template <typename Callback>
+    static size_t ForEachRecord(std::string_view data, Callback callback, bool verify_checksums = true);
+
+private:
+    // Parses the record framed at data[pos] and moves pos past it; false if the record
+    // is incomplete or corrupt, pos is not moved then
+    static bool TryParseRecord(std::string_view data, size_t& pos, WalRecord& record, bool verify_checksum);
+
+    const std::string path_;
+    const WriteAheadLogOptions options_;
+    int fd_ = -1;
+    size_t file_size_ = 0;
+    std::string pending_;
+    size_t pending_records_ = 0;
+    std::string recovered_;
+    size_t recovered_size_ = 0;
+    size_t discarded_size_ = 0;
+};
+
+template <typename Callback>
+size_t WriteAheadLog::ForEachRecord(std::string_view data, Callback callback, bool verify_checksums) {
+    WalRecord record;
+    size_t pos = 0;
+    while (TryParseRecord(data, pos, record, verify_checksums)) {
+        callback(static_cast<const WalRecord&>(record));
+    }
+    return pos;
+}